@@ -0,0 +1,38 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "alloc_counter.h"
+
+static std::atomic<size_t> alloc_count{ 0 };
+static std::atomic<size_t> alloc_bytes{ 0 };
+
+size_t AllocCounter::allocations() { return alloc_count.load(std::memory_order_relaxed); }
+size_t AllocCounter::bytes() { return alloc_bytes.load(std::memory_order_relaxed); }
+
+void AllocCounter::reset()
+{
+	alloc_count.store(0, std::memory_order_relaxed);
+	alloc_bytes.store(0, std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+// Counters maintained by the replacement operator new/delete in alloc_counter.cpp.
+// Link that file into a benchmark to have every heap allocation counted.
+struct AllocCounter
+{
+    static size_t allocations();
+    static size_t bytes();
+    static void reset();
+};
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "highs-wrapper/optimization_model.h"
+
+//
+// Time to assemble the highs matrix from wrapper rows, for 1..32 threads, and
+// the column-wise build against a row-wise build that highs has to transpose.
+// usage: bench-assembly [rows=1000000] [nnz per row=50]
+//
+int main(int argc, char* argv[])
+{
+	const HighsInt num_row = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	const HighsInt row_nnz = argc > 2 ? std::atoi(argv[2]) : 50;
+	const HighsInt num_col = std::max(num_row / 10, row_nnz);
+
+	OptimizationModel m;
+	m.addVars(num_col, nullptr, nullptr);
+
+	// random rows with distinct columns, added in blocks to bound memory
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<HighsInt> pick(0, num_col - row_nnz);
+	std::vector<double> lower, upper, value;
+	std::vector<HighsInt> start, index;
+
+	for (HighsInt block = 0; block < num_row; block += 10000) {
+		HighsInt count = std::min<HighsInt>(10000, num_row - block);
+		lower.assign(count, -kHighsInf);
+		upper.assign(count, 1.0);
+		start.clear();
+		index.clear();
+		value.clear();
+
+		for (HighsInt r = 0; r < count; ++r) {
+			start.push_back(index.size());
+			HighsInt first = pick(rng);
+			for (HighsInt k = 0; k < row_nnz; ++k) {
+				index.push_back(first + k);
+				value.push_back(1.0 + k);
+			}
+		}
+
+		m.addConstrs(count, lower.data(), upper.data(), index.size(), start.data(), index.data(), value.data());
+	}
+
+	std::cout << num_row << " rows x " << row_nnz << " nnz" << std::endl;
+
+	m.setAssemblyFormat(OptimizationModel::AssemblyFormat::Rowwise);
+
+	for (int threads = 1; threads <= 32; threads *= 2) {
+		m.setAssemblyThreads(threads);
+
+		HighsModel model;
+		auto start_time = std::chrono::steady_clock::now();
+		m.assemble(model);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+
+		std::cout << threads << " threads: " << elapsed.count() << " ms" << std::endl;
+	}
+
+	m.setAssemblyThreads(0);
+
+	for (auto format : { OptimizationModel::AssemblyFormat::Rowwise, OptimizationModel::AssemblyFormat::Colwise }) {
+		m.setAssemblyFormat(format);
+
+		HighsModel model;
+		auto start_time = std::chrono::steady_clock::now();
+		m.assemble(model);
+		model.lp_.a_matrix_.ensureColwise();	// what passModel does with a row-wise matrix
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+
+		std::cout << (format == OptimizationModel::AssemblyFormat::Colwise ? "column-wise: " : "row-wise + transpose: ")
+			<< elapsed.count() << " ms" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "highs-wrapper/optimization_model.h"
+
+//
+// Time to evaluate all rows at a point, per kernel and for 1..32 threads, as a local
+// search heuristic checking candidate solutions would.
+// usage: bench-evaluate [rows=1000000] [nnz per row=20] [repeats=20]
+//
+template <typename F>
+static double time(int repeats, F f)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeats; ++i)
+		f();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / repeats;
+}
+
+int main(int argc, char* argv[])
+{
+	const HighsInt num_row = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	const HighsInt row_nnz = argc > 2 ? std::atoi(argv[2]) : 20;
+	const int repeats = argc > 3 ? std::atoi(argv[3]) : 20;
+	const HighsInt num_col = std::max(num_row / 2, row_nnz);
+
+	OptimizationModel m;
+	m.addVars(num_col, nullptr, nullptr);
+
+	// rows over scattered columns, so the kernels have to gather
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<HighsInt> pick(0, num_col - 1);
+	std::vector<double> lower(num_row, -kHighsInf), upper(num_row, 1.0), value;
+	std::vector<HighsInt> start, index;
+
+	for (HighsInt r = 0; r < num_row; ++r) {
+		start.push_back(index.size());
+		for (HighsInt k = 0; k < row_nnz; ++k) {
+			index.push_back(pick(rng));
+			value.push_back(1.0 + k);
+		}
+	}
+
+	m.addConstrs(num_row, lower.data(), upper.data(), index.size(), start.data(), index.data(), value.data());
+
+	std::vector<double> x(num_col, 0.5), activity(num_row);
+	m.evaluate(x.data(), activity.data());
+
+	std::cout << num_row << " rows x " << row_nnz << " nnz, best kernel " << (int)evaluationKernel() << std::endl;
+
+	HighsSparseMatrix a = m.highs.getLp().a_matrix_;
+	a.ensureRowwise();
+	const double* row_lower = m.highs.getLp().row_lower_.data();
+	const double* row_upper = m.highs.getLp().row_upper_.data();
+
+	const char* names[] = { "scalar", "avx2", "avx512" };
+	for (auto kernel : { ModelKernel::Scalar, ModelKernel::Avx2, ModelKernel::Avx512 }) {
+		if (kernel > evaluationKernel())
+			break;
+
+		double ms = time(repeats, [&]() { evaluateRows(a, row_lower, row_upper, x.data(), activity.data(), 0, num_row, kernel); });
+		std::cout << names[(int)kernel] << ": " << ms << " ms" << std::endl;
+	}
+
+	for (int threads = 1; threads <= 32; threads *= 2) {
+		double ms = time(repeats, [&]() { m.evaluate(x.data(), activity.data(), threads); });
+		std::cout << threads << " threads: " << ms << " ms" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+#include "highs-wrapper/optimization_model.h"
+#include "alloc_counter.h"
+
+//
+// Heap allocations per constraint for long operator chains, e.g. a + b + ... + z <= 5,
+// for building and destroying a whole model through the bulk API, and for long objectives.
+//
+template <typename F>
+static void report(const char* name, int count, F build)
+{
+	OptimizationModel m;
+	auto v = m.addBinaries(26);
+
+	AllocCounter::reset();
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < count; ++i)
+		build(m, v);
+
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << name << ": "
+		<< (double)AllocCounter::allocations() / count << " allocations, "
+		<< (double)AllocCounter::bytes() / count << " bytes, "
+		<< elapsed.count() / count << " us per constraint" << std::endl;
+}
+
+static void lifetime(int count)
+{
+	const HighsInt row_nnz = 10;
+	std::vector<double> lower(count, -kHighsInf), upper(count, 1.0), value;
+	std::vector<HighsInt> start, index;
+
+	for (HighsInt r = 0; r < count; ++r) {
+		start.push_back(index.size());
+		for (HighsInt k = 0; k < row_nnz; ++k) {
+			index.push_back((r + k) % count);
+			value.push_back(1.0);
+		}
+	}
+
+	AllocCounter::reset();
+	auto start_time = std::chrono::steady_clock::now();
+
+	auto m = std::unique_ptr<OptimizationModel>(new OptimizationModel());
+	m->addVars(count, nullptr, nullptr);
+	m->addConstrs(count, lower.data(), upper.data(), index.size(), start.data(), index.data(), value.data());
+
+	std::chrono::duration<double, std::milli> built = std::chrono::steady_clock::now() - start_time;
+	size_t allocations = AllocCounter::allocations();
+
+	start_time = std::chrono::steady_clock::now();
+	m.reset();
+	std::chrono::duration<double, std::milli> destroyed = std::chrono::steady_clock::now() - start_time;
+
+	std::cout << count << " columns and rows: " << allocations << " allocations, "
+		<< built.count() << " ms to build, " << destroyed.count() << " ms to destroy" << std::endl;
+}
+
+static void objective(int count)
+{
+	OptimizationModel m;
+	auto v = m.addVars(count, nullptr, nullptr);
+	std::vector<double> c(count, 2.0);
+
+	auto time = [&](const char* name, std::function<ModelLinearExpression()> build) {
+		AllocCounter::reset();
+		auto start = std::chrono::steady_clock::now();
+		ModelLinearExpression expr = build();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << count << " term objective, " << name << ": " << AllocCounter::allocations() << " allocations, "
+			<< elapsed.count() << " ms" << std::endl;
+	};
+
+	time("+= loop", [&]() {
+		ModelLinearExpression expr;
+		for (int i = 0; i < count; ++i)
+			expr += c[i] * v[i];
+		return expr;
+	});
+
+	time("quicksum", [&]() { return quicksum(c, v); });
+}
+
+int main(int argc, char* argv[])
+{
+	const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+	report("26 term chain", count, [](OptimizationModel& m, const std::vector<ModelVar>& v) {
+		m.addConstr(v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7] + v[8] + v[9] + v[10] + v[11] + v[12] +
+			v[13] + v[14] + v[15] + v[16] + v[17] + v[18] + v[19] + v[20] + v[21] + v[22] + v[23] + v[24] + v[25] <= 5);
+	});
+
+	report("26 term weighted chain", count, [](OptimizationModel& m, const std::vector<ModelVar>& v) {
+		m.addConstr(1*v[0] + 2*v[1] + 3*v[2] + 4*v[3] + 5*v[4] + 6*v[5] + 7*v[6] + 8*v[7] + 9*v[8] + 10*v[9] + 11*v[10] + 12*v[11] + 13*v[12] +
+			14*v[13] + 15*v[14] + 16*v[15] + 17*v[16] + 18*v[17] + 19*v[18] + 20*v[19] + 21*v[20] + 22*v[21] + 23*v[22] + 24*v[23] + 25*v[24] + 26*v[25] >= 1);
+	});
+
+	report("26 term += loop", count, [](OptimizationModel& m, const std::vector<ModelVar>& v) {
+		ModelLinearExpression expr;
+		for (const auto& x : v)
+			expr += x;
+		m.addConstr(std::move(expr) == 1);
+	});
+
+	lifetime(10 * count);
+	objective(100 * count);
+
+	return 0;
+}
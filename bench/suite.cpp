@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "highs-wrapper/optimization_model.h"
+#include "alloc_counter.h"
+
+//
+// Cost of each step from generated data to solution values, through the wrapper and
+// through plain HiGHS, so wrapper overhead and regressions show up per step: building
+// the row expressions, addConstr, the assembly and passModel of update(), solve and
+// reading the solution. Every step reports time, heap allocations and the peak RSS after it.
+// usage: bench-suite [model=all|transport|setcover|knapsack|sparse] [scale=100000] [solve=1] [path=both|wrapper|highs]
+// scale is roughly the number of columns, 1e3 to 1e7. Solves stop after 60 s. Peak RSS is
+// the high-water mark of the process, so compare it between runs of a single model and path.
+//
+
+/// <summary>
+/// A generated problem in the row-wise layout of Highs::addRows, shared by both paths.
+/// </summary>
+struct Problem
+{
+	HighsInt num_col = 0;
+	std::vector<double> cost, col_lower, col_upper;
+	bool integer = false;
+	ObjSense sense = ObjSense::kMinimize;
+
+	std::vector<double> row_lower, row_upper, value;
+	std::vector<HighsInt> start = { 0 }, index;
+
+	void addRow(double lower, double upper)
+	{
+		row_lower.push_back(lower);
+		row_upper.push_back(upper);
+		start.push_back(index.size());
+	}
+
+	HighsInt numRow() const { return row_lower.size(); }
+};
+
+// suppliers x customers with x_ij >= 0, supply rows <= and demand rows >= and enough supply
+static Problem transport(HighsInt scale, std::mt19937& rng)
+{
+	HighsInt suppliers = std::max<HighsInt>(2, (HighsInt)std::sqrt((double)scale) / 4);
+	HighsInt customers = std::max<HighsInt>(2, scale / suppliers);
+	std::uniform_real_distribution<double> cost(1.0, 100.0), demand(1.0, 10.0);
+
+	Problem p;
+	p.num_col = suppliers * customers;
+	p.col_lower.assign(p.num_col, 0.0);
+	p.col_upper.assign(p.num_col, kHighsInf);
+	for (HighsInt c = 0; c < p.num_col; ++c)
+		p.cost.push_back(cost(rng));
+
+	std::vector<double> demands(customers);
+	double total = 0.0;
+	for (auto& d : demands)
+		total += d = demand(rng);
+
+	for (HighsInt i = 0; i < suppliers; ++i) {
+		for (HighsInt j = 0; j < customers; ++j) {
+			p.index.push_back(i * customers + j);
+			p.value.push_back(1.0);
+		}
+		p.addRow(-kHighsInf, 1.2 * total / suppliers);
+	}
+
+	for (HighsInt j = 0; j < customers; ++j) {
+		for (HighsInt i = 0; i < suppliers; ++i) {
+			p.index.push_back(i * customers + j);
+			p.value.push_back(1.0);
+		}
+		p.addRow(demands[j], kHighsInf);
+	}
+
+	return p;
+}
+
+// binary sets, every element is covered by 5 random sets, at least once
+static Problem setCover(HighsInt scale, std::mt19937& rng)
+{
+	// 5 distinct sets per element need at least 5 columns
+	scale = std::max<HighsInt>(scale, 10);
+
+	Problem p;
+	p.num_col = scale;
+	p.integer = true;
+	p.col_lower.assign(scale, 0.0);
+	p.col_upper.assign(scale, 1.0);
+
+	std::uniform_real_distribution<double> cost(1.0, 10.0);
+	for (HighsInt c = 0; c < scale; ++c)
+		p.cost.push_back(cost(rng));
+
+	std::uniform_int_distribution<HighsInt> pick(0, scale - 1);
+	for (HighsInt e = 0; e < scale / 2; ++e) {
+		HighsInt first = p.index.size();
+		while ((HighsInt)p.index.size() - first < 5) {
+			HighsInt set = pick(rng);
+			if (std::find(p.index.begin() + first, p.index.end(), set) == p.index.end()) {
+				p.index.push_back(set);
+				p.value.push_back(1.0);
+			}
+		}
+		std::sort(p.index.begin() + first, p.index.end());
+		p.addRow(1.0, kHighsInf);
+	}
+
+	return p;
+}
+
+// binary items under 5 dense capacity rows, maximising value
+static Problem knapsack(HighsInt scale, std::mt19937& rng)
+{
+	Problem p;
+	p.num_col = scale;
+	p.integer = true;
+	p.sense = ObjSense::kMaximize;
+	p.col_lower.assign(scale, 0.0);
+	p.col_upper.assign(scale, 1.0);
+
+	std::uniform_real_distribution<double> value(1.0, 100.0), weight(1.0, 50.0);
+	for (HighsInt c = 0; c < scale; ++c)
+		p.cost.push_back(value(rng));
+
+	for (int k = 0; k < 5; ++k) {
+		double total = 0.0;
+		for (HighsInt c = 0; c < scale; ++c) {
+			p.index.push_back(c);
+			p.value.push_back(weight(rng));
+			total += p.value.back();
+		}
+		p.addRow(-kHighsInf, total / 4);
+	}
+
+	return p;
+}
+
+// bounded columns and half as many rows with 10 random nonzeros, maximising
+static Problem sparse(HighsInt scale, std::mt19937& rng)
+{
+	Problem p;
+	p.num_col = std::max<HighsInt>(scale, 10);
+	p.sense = ObjSense::kMaximize;
+	p.col_lower.assign(p.num_col, 0.0);
+	p.col_upper.assign(p.num_col, 10.0);
+
+	std::uniform_real_distribution<double> coeff(1.0, 10.0);
+	for (HighsInt c = 0; c < p.num_col; ++c)
+		p.cost.push_back(coeff(rng));
+
+	std::uniform_int_distribution<HighsInt> pick(0, p.num_col - 10);
+	for (HighsInt r = 0; r < p.num_col / 2; ++r) {
+		HighsInt first = pick(rng);
+		for (HighsInt k = 0; k < 10; ++k) {
+			p.index.push_back(first + k);
+			p.value.push_back(coeff(rng));
+		}
+		p.addRow(-kHighsInf, 50.0 * coeff(rng));
+	}
+
+	return p;
+}
+
+static double peakRssMB()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__APPLE__)
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / (1024.0 * 1024.0);		// bytes
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;				// kilobytes
+#endif
+}
+
+static void step(const char* name, std::function<void()> f)
+{
+	AllocCounter::reset();
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "  " << name << ": " << elapsed.count() << " ms, " << AllocCounter::allocations() << " allocations, "
+		<< AllocCounter::bytes() / (1024.0 * 1024.0) << " MB allocated, peak RSS " << peakRssMB() << " MB" << std::endl;
+}
+
+static void quiet(Highs& highs)
+{
+	highs.setOptionValue("output_flag", false);
+	highs.setOptionValue("time_limit", 60.0);
+}
+
+static void wrapper(const Problem& p, bool solve)
+{
+	std::cout << " wrapper" << std::endl;
+
+	OptimizationModel m;
+	quiet(m.highs);
+
+	std::vector<ModelVar> vars;
+	std::vector<ModelLinearExpression> rows;
+	ModelLinearExpression objective;
+	std::vector<HighsVarType> integrality(p.num_col, p.integer ? HighsVarType::kInteger : HighsVarType::kContinuous);
+
+	step("addVars", [&]() {
+		vars = m.addVars(p.num_col, p.col_lower.data(), p.col_upper.data(), integrality.data());
+	});
+
+	// the handles of each row, as a model written against the wrapper has them at hand
+	std::vector<ModelVar> row_vars(p.index.size());
+	for (size_t k = 0; k < p.index.size(); ++k)
+		row_vars[k] = vars[p.index[k]];
+
+	step("expressions", [&]() {
+		rows.reserve(p.numRow());
+		for (HighsInt r = 0; r < p.numRow(); ++r) {
+			HighsInt first = p.start[r], count = p.start[r + 1] - first;
+			rows.push_back(quicksum(p.value.data() + first, row_vars.data() + first, count, 1));
+		}
+		objective = quicksum(p.cost.data(), vars.data(), p.num_col, 0);
+	});
+
+	step("addConstr", [&]() {
+		for (HighsInt r = 0; r < p.numRow(); ++r) {
+			ModelLinearExpression& expr = rows[r];
+			if (p.row_lower[r] > -kHighsInf && p.row_upper[r] < kHighsInf)
+				m.addConstr(p.row_lower[r] <= std::move(expr) <= p.row_upper[r]);
+			else if (p.row_lower[r] > -kHighsInf)
+				m.addConstr(std::move(expr) >= p.row_lower[r]);
+			else
+				m.addConstr(std::move(expr) <= p.row_upper[r]);
+		}
+		m.setObjective(std::move(objective), p.sense);
+	});
+
+	rows = std::vector<ModelLinearExpression>();
+
+	// the two halves of update(), timed apart like the highs path
+	HighsModel model;
+	step("assembly", [&]() { m.assemble(model); });
+
+	step("passModel", [&]() {
+		Highs highs;
+		quiet(highs);
+		highs.passModel(std::move(model));
+	});
+
+	if (!solve)
+		return;
+
+	// the model's own highs gets the model untimed, so the solve step is the solve alone
+	m.update();
+
+	step("solve", [&]() { m.optimize(); });
+
+	if (!m.highs.getSolution().value_valid) {
+		std::cout << "  no solution" << std::endl;
+		return;
+	}
+
+	double sum = 0.0;
+	step("solution, getValue", [&]() {
+		for (const auto& v : vars)
+			sum += v.getValue();
+	});
+
+	step("solution, colValues", [&]() {
+		for (double x : m.colValues())
+			sum += x;
+	});
+
+	std::cout << "  objective " << m.highs.getInfo().objective_function_value << std::endl;
+}
+
+static void plain(const Problem& p, bool solve)
+{
+	std::cout << " highs" << std::endl;
+
+	Highs highs;
+	quiet(highs);
+	HighsModel model;
+
+	step("build HighsLp", [&]() {
+		HighsLp& lp = model.lp_;
+		lp.num_col_ = p.num_col;
+		lp.num_row_ = p.numRow();
+		lp.sense_ = p.sense;
+		lp.col_cost_ = p.cost;
+		lp.col_lower_ = p.col_lower;
+		lp.col_upper_ = p.col_upper;
+		lp.row_lower_ = p.row_lower;
+		lp.row_upper_ = p.row_upper;
+
+		if (p.integer)
+			lp.integrality_.assign(p.num_col, HighsVarType::kInteger);
+
+		lp.a_matrix_.format_ = MatrixFormat::kRowwise;
+		lp.a_matrix_.num_col_ = lp.num_col_;
+		lp.a_matrix_.num_row_ = lp.num_row_;
+		lp.a_matrix_.start_ = p.start;
+		lp.a_matrix_.index_ = p.index;
+		lp.a_matrix_.value_ = p.value;
+	});
+
+	step("passModel", [&]() { highs.passModel(std::move(model)); });
+
+	if (!solve)
+		return;
+
+	step("solve", [&]() { highs.run(); });
+
+	if (!highs.getSolution().value_valid) {
+		std::cout << "  no solution" << std::endl;
+		return;
+	}
+
+	double sum = 0.0;
+	step("solution", [&]() {
+		for (double x : highs.getSolution().col_value)
+			sum += x;
+	});
+
+	std::cout << "  objective " << highs.getInfo().objective_function_value << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	const std::string which = argc > 1 ? argv[1] : "all";
+	const HighsInt scale = argc > 2 ? (HighsInt)std::atof(argv[2]) : 100000;
+	const bool solve = argc > 3 ? std::atoi(argv[3]) != 0 : true;
+	const std::string path = argc > 4 ? argv[4] : "both";
+
+	const std::pair<const char*, Problem (*)(HighsInt, std::mt19937&)> generators[] = {
+		{ "transport", transport }, { "setcover", setCover }, { "knapsack", knapsack }, { "sparse", sparse },
+	};
+
+	for (const auto& generator : generators) {
+		if (which != "all" && which != generator.first)
+			continue;
+
+		std::mt19937 rng(42);
+		Problem p = generator.second(scale, rng);
+		std::cout << generator.first << ": " << p.num_col << " columns, " << p.numRow() << " rows, "
+			<< p.index.size() << " nonzeros" << std::endl;
+
+		if (path != "highs")
+			wrapper(p, solve);
+		if (path != "wrapper")
+			plain(p, solve);
+	}
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// types whose members only hold memory of the arena they live in set kArenaReleased, the
+// arena then frees them with its blocks without running their destructors
+template <typename T, typename = void> struct ArenaReleased : std::false_type {};
+template <typename T> struct ArenaReleased<T, decltype(void(T::kArenaReleased))> : std::integral_constant<bool, T::kArenaReleased> {};
+
+/// <summary>
+/// Storage owned by a model. Columns, rows and row terms are bump-allocated from a few large
+/// blocks that are only released together, so building a model costs a handful of mallocs
+/// and tearing it down a handful of frees, without visiting the objects in them. Term
+/// buffers come in power of two size classes and go to a free list of their class when a
+/// row grows or is removed, so rebuilding rows reuses the space of their old terms.
+/// Not thread-safe.
+/// </summary>
+class ModelArena
+{
+  private:
+    static const size_t first_block = 64 * 1024;
+    static const size_t max_block = 64 * 1024 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* next = nullptr;
+    size_t left = 0;
+    size_t block_size = first_block;
+
+    // objects with a non-trivial destructor, run when the arena goes
+    std::vector<std::pair<void*, void (*)(void*)>> destructors;
+
+    // freed buffers of 2^k bytes at index k, linked through their first bytes
+    std::vector<void*> free_buffers;
+
+    static size_t sizeClass(size_t bytes) {
+        size_t k = 4;
+        while ((size_t(1) << k) < bytes)
+            ++k;
+        return k;
+    }
+
+    void grow(size_t bytes) {
+        size_t size = std::max(block_size, bytes);
+        blocks.emplace_back(new char[size]);
+        next = blocks.back().get();
+        left = size;
+        block_size = 2 * block_size < max_block ? 2 * block_size : max_block;
+    }
+
+  public:
+    ModelArena() {}
+    ModelArena(const ModelArena&) = delete;
+    ModelArena& operator=(const ModelArena&) = delete;
+
+    ~ModelArena() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+            it->second(it->first);
+    }
+
+    void* allocate(size_t bytes, size_t align) {
+        size_t pad = (align - (uintptr_t)next % align) % align;
+        if (pad + bytes > left) {
+            grow(bytes + align);
+            pad = (align - (uintptr_t)next % align) % align;
+        }
+
+        void* p = next + pad;
+        next += pad + bytes;
+        left -= pad + bytes;
+        return p;
+    }
+
+    // buffer of at least bytes, from the free list of its size class if that has one
+    void* allocateBuffer(size_t bytes) {
+        size_t k = sizeClass(bytes);
+        if (k < free_buffers.size() && free_buffers[k]) {
+            void* p = free_buffers[k];
+            free_buffers[k] = *static_cast<void**>(p);
+            return p;
+        }
+
+        return allocate(size_t(1) << k, alignof(std::max_align_t));
+    }
+
+    void deallocateBuffer(void* p, size_t bytes) {
+        size_t k = sizeClass(bytes);
+        if (k >= free_buffers.size())
+            free_buffers.resize(k + 1, nullptr);
+
+        *static_cast<void**>(p) = free_buffers[k];
+        free_buffers[k] = p;
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* p = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value && !ArenaReleased<T>::value)
+            destructors.push_back({ p, [](void* q) { static_cast<T*>(q)->~T(); } });
+        return p;
+    }
+};
+
+/// <summary>
+/// Allocator for containers that live in a model's arena. Default constructed it uses the
+/// heap, and copies of a container always do, so only the model's own rows use the arena.
+/// Freed arena buffers are kept for reuse by the arena, not returned to the heap.
+/// </summary>
+template <typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    ModelArena* arena = nullptr;
+
+    ArenaAllocator() {}
+    ArenaAllocator(ModelArena* arena) : arena(arena) {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U>& a) : arena(a.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena)
+            return static_cast<T*>(arena->allocateBuffer(n * sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (arena)
+            arena->deallocateBuffer(p, n * sizeof(T));
+        else
+            ::operator delete(p);
+    }
+
+    ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+    template <typename U> bool operator==(const ArenaAllocator<U>& a) const { return arena == a.arena; }
+    template <typename U> bool operator!=(const ArenaAllocator<U>& a) const { return arena != a.arena; }
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <unordered_map>
 #include "linear_expression.h"
 
 class OptimizationModel;
@@ -9,14 +10,48 @@ class ModelRow
   private:
     OptimizationModel* model;
     int row;
+    uint32_t name;  // id in the model's row NameTable
+
+    // column slot id -> position in expr, built on first chgCoeff/getCoeff when indexed is
+    // unset; for a streamed row column index -> offset in its part of the streamed matrix
+    using Index = std::unordered_map<uint32_t, uint32_t, std::hash<uint32_t>, std::equal_to<uint32_t>,
+        ArenaAllocator<std::pair<const uint32_t, uint32_t>>>;
+    Index position;
+    bool indexed = false;
+
+    // adopted row whose terms were read back from highs into expr for chgCoeff/getCoeff,
+    // which keep both in step from then on
+    bool mirrored = false;
 
   public:
     friend class ModelConstraint;
     friend class OptimizationModel;
 
-    ModelRow(OptimizationModel* model, int row, std::string name = "") : model(model), row(row), name(name) {}
-    std::string name;
+    // the terms and the index only ever hold memory of the model's arena, so the arena frees
+    // rows with its blocks instead of running their destructors
+    static const bool kArenaReleased = true;
+
+    ModelRow(OptimizationModel* model, int row, uint32_t name, ModelArena& arena) :
+        model(model), row(row), name(name), position(Index::allocator_type(&arena)), expr(arena) {}
     ModelLinearExpression expr;
+
+    void dropIndex() {
+        position.clear();
+        indexed = false;
+    }
+
+    // hand the terms and the index back to the arena, for a removed row whose handles live on
+    void release() {
+        decltype(expr.terms)(expr.terms.get_allocator()).swap(expr.terms);
+        Index(position.get_allocator()).swap(position);
+        indexed = false;
+    }
+
+    // rows adopted from highs keep their coefficients there, expr stays empty
+    bool adopted = false;
+
+    // row of the model's streamed CSR until update() passes it to highs, see rowBuilder()
+    int streamed = -1;
 };
 
 class ModelConstraint
@@ -41,14 +76,9 @@ class ModelConstraint
         return row ? row->row : -2;
     }
 
-    void remove() {
-        throw std::runtime_error("Not implemented");
+    void remove();
 
-        //if (row) {
-        //    row->model->remove(*this);
-        //    row.reset();
-        //}
-    }
+    std::string getName() const;
 
     bool sameAs(ModelConstraint c2) {
         return (row.get() == c2.row.get());
@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include "evaluate.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MODEL_KERNEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define MODEL_KERNEL_TARGET(isa)
+#else
+#define MODEL_KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+//
+// Row kernels for OptimizationModel::evaluate: one dot product per row of the CSR matrix
+// highs holds, gathering x through the column indices. The AVX2 and AVX-512 kernels are
+// compiled for their instruction set only, and picked at runtime when the CPU has it.
+//
+
+static inline double violation(double activity, double lower, double upper)
+{
+	return std::max(lower - activity, activity - upper);
+}
+
+static double rowsScalar(const HighsInt* start, const HighsInt* index, const double* value, const double* lower,
+	const double* upper, const double* x, double* activity, HighsInt begin, HighsInt end)
+{
+	double worst = 0.0;
+
+	for (HighsInt r = begin; r < end; ++r) {
+		double a = 0.0;
+		for (HighsInt k = start[r]; k < start[r + 1]; ++k)
+			a += value[k] * x[index[k]];
+
+		if (activity) activity[r] = a;
+		worst = std::max(worst, violation(a, lower[r], upper[r]));
+	}
+	return worst;
+}
+
+#ifdef MODEL_KERNEL_X86
+
+MODEL_KERNEL_TARGET("avx2,fma")
+static double rowsAvx2(const HighsInt* start, const HighsInt* index, const double* value, const double* lower,
+	const double* upper, const double* x, double* activity, HighsInt begin, HighsInt end)
+{
+	double worst = 0.0;
+
+	for (HighsInt r = begin; r < end; ++r) {
+		HighsInt k = start[r];
+		HighsInt last = start[r + 1];
+		__m256d sum = _mm256_setzero_pd();
+
+		for (; k + 4 <= last; k += 4) {
+#ifdef HIGHSINT64
+			__m256d xk = _mm256_i64gather_pd(x, _mm256_loadu_si256((const __m256i*)(index + k)), 8);
+#else
+			__m256d xk = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(index + k)), 8);
+#endif
+			sum = _mm256_fmadd_pd(_mm256_loadu_pd(value + k), xk, sum);
+		}
+
+		__m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		double a = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+
+		for (; k < last; ++k)
+			a += value[k] * x[index[k]];
+
+		if (activity) activity[r] = a;
+		worst = std::max(worst, violation(a, lower[r], upper[r]));
+	}
+	return worst;
+}
+
+MODEL_KERNEL_TARGET("avx512f")
+static double rowsAvx512(const HighsInt* start, const HighsInt* index, const double* value, const double* lower,
+	const double* upper, const double* x, double* activity, HighsInt begin, HighsInt end)
+{
+	double worst = 0.0;
+
+	for (HighsInt r = begin; r < end; ++r) {
+		HighsInt k = start[r];
+		HighsInt last = start[r + 1];
+		__m512d sum = _mm512_setzero_pd();
+
+		for (; k + 8 <= last; k += 8) {
+#ifdef HIGHSINT64
+			__m512d xk = _mm512_i64gather_pd(_mm512_loadu_si512(index + k), x, 8);
+#else
+			__m512d xk = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(index + k)), x, 8);
+#endif
+			sum = _mm512_fmadd_pd(_mm512_loadu_pd(value + k), xk, sum);
+		}
+
+		double a = _mm512_reduce_add_pd(sum);
+
+		for (; k < last; ++k)
+			a += value[k] * x[index[k]];
+
+		if (activity) activity[r] = a;
+		worst = std::max(worst, violation(a, lower[r], upper[r]));
+	}
+	return worst;
+}
+
+static ModelKernel detectKernel()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return ModelKernel::Scalar;
+
+	__cpuid(info, 1);
+	bool fma = info[2] & (1 << 12);
+	bool osxsave = info[2] & (1 << 27);
+	if (!osxsave)
+		return ModelKernel::Scalar;
+
+	// the OS has to save the ymm and zmm registers, not only the CPU support them
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+
+	if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)))
+		return ModelKernel::Avx512;
+	if ((xcr0 & 0x6) == 0x6 && fma && (info[1] & (1 << 5)))
+		return ModelKernel::Avx2;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return ModelKernel::Avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return ModelKernel::Avx2;
+#endif
+	return ModelKernel::Scalar;
+}
+
+#else
+
+static ModelKernel detectKernel()
+{
+	return ModelKernel::Scalar;
+}
+
+#endif
+
+ModelKernel evaluationKernel()
+{
+	static const ModelKernel kernel = detectKernel();
+	return kernel;
+}
+
+double evaluateRows(const HighsSparseMatrix& matrix, const double* lower, const double* upper, const double* x,
+	double* activity, HighsInt begin, HighsInt end, ModelKernel kernel)
+{
+	const HighsInt* start = matrix.start_.data();
+	const HighsInt* index = matrix.index_.data();
+	const double* value = matrix.value_.data();
+
+	// a kernel the CPU lacks falls back to the best one it has
+	if (kernel > evaluationKernel())
+		kernel = evaluationKernel();
+
+	switch (kernel) {
+#ifdef MODEL_KERNEL_X86
+	case ModelKernel::Avx512:
+		return rowsAvx512(start, index, value, lower, upper, x, activity, begin, end);
+	case ModelKernel::Avx2:
+		return rowsAvx2(start, index, value, lower, upper, x, activity, begin, end);
+#endif
+	default:
+		return rowsScalar(start, index, value, lower, upper, x, activity, begin, end);
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+
+#include "highs/Highs.h"
+
+/// <summary>
+/// Row activities of a point and the largest violation of a row or column bound, see
+/// OptimizationModel::evaluate.
+/// </summary>
+struct ModelEvaluation
+{
+    std::vector<double> row_activity;
+    double max_infeasibility = 0.0;
+};
+
+// instruction set of the row kernels, the best one the CPU supports is picked on first use
+enum class ModelKernel { Scalar, Avx2, Avx512 };
+ModelKernel evaluationKernel();
+
+/// <summary>
+/// Activities of rows [begin, end) of a row-wise matrix at x, stored in activity unless it is
+/// null. Returns the largest violation of the row bounds, 0 when all rows are satisfied.
+/// Kernels sum in a different order, so their results can differ in the last bits.
+/// </summary>
+double evaluateRows(const HighsSparseMatrix& matrix, const double* lower, const double* upper, const double* x,
+    double* activity, HighsInt begin, HighsInt end, ModelKernel kernel = evaluationKernel());
@@ -0,0 +1,286 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include <type_traits>
+
+//
+// Expression templates for arithmetic on variables and constants. x0 + 2*x1 - 3 builds a
+// small tree on the stack instead of a ModelLinearExpression at every operator; the tree is
+// evaluated once into an exactly sized buffer, when it is added as a constraint or converted
+// to a ModelLinearExpression. Operations involving a ModelLinearExpression still go through
+// its own operators.
+//
+
+/// <summary>
+/// Base of all expression nodes. Converts to ModelLinearExpression, so nodes can be passed
+/// wherever an expression is expected, and has its API, so code written when arithmetic
+/// returned expressions keeps working with auto: the first call builds the expression from
+/// the tree, and from then on the node stands for that expression instead.
+/// </summary>
+template <typename Node>
+struct ModelExprNode : ModelExprTag
+{
+    // set by the first call of the expression API
+    std::unique_ptr<ModelLinearExpression> built;
+
+    ModelExprNode() {}
+    ModelExprNode(const ModelExprNode& n) : built(n.built ? new ModelLinearExpression(*n.built) : nullptr) {}
+    ModelExprNode(ModelExprNode&& n) = default;
+
+    ModelExprNode& operator=(const ModelExprNode& n) {
+        built.reset(n.built ? new ModelLinearExpression(*n.built) : nullptr);
+        return *this;
+    }
+    ModelExprNode& operator=(ModelExprNode&& n) = default;
+
+    // e = e + x changes the tree's type, so assigning any other expression materialises it
+    Node& operator=(const ModelLinearExpression& e) {
+        built.reset(new ModelLinearExpression(e));
+        return static_cast<Node&>(*this);
+    }
+
+    operator ModelLinearExpression() const;
+
+    // terms of the node, from the expression once there is one, see ModelLinearExpression::append
+    size_t count() const { return built ? built->terms.size() : Node::length; }
+    template <typename F> void visit(double m, F& f) const;
+    double offset(double m) const { return built ? m * built->constant : static_cast<const Node&>(*this).constant(m); }
+    OptimizationModel* owner() const { return built ? built->model : static_cast<const Node&>(*this).model(); }
+
+    ModelLinearExpression& expression() const;
+
+    unsigned int size() const { return expression().size(); }
+    ModelVar getVar(int i) const { return expression().getVar(i); }
+    double getCoeff(int i) const { return expression().getCoeff(i); }
+    double getConstant() const { return expression().getConstant(); }
+    double getValue() const { return expression().getValue(); }
+
+    void addTerms(const double* coeff, const ModelVar* var, size_t cnt, int threads = 1) { expression().addTerms(coeff, var, cnt, threads); }
+    void reserve(size_t n) { expression().reserve(n); }
+    template <typename T> void operator+=(const T& t) { expression() += t; }
+    template <typename T> void operator-=(const T& t) { expression() -= t; }
+    void operator*=(double mult) { expression() *= mult; }
+    void operator/=(double a) { expression() /= a; }
+    void remove(int i) { expression().remove(i); }
+    bool remove(ModelVar v) { return expression().remove(v); }
+    void compress(double tolerance = kHighsTiny) { expression().compress(tolerance); }
+};
+
+struct ModelConstNode : ModelExprNode<ModelConstNode>
+{
+    using ModelExprNode::operator=;
+    static const size_t length = 0;
+    double value;
+
+    ModelConstNode(double value) : value(value) {}
+
+    template <typename F> void each(double, F&) const {}
+    double constant(double m) const { return m * value; }
+    OptimizationModel* model() const { return nullptr; }
+};
+
+struct ModelVarNode : ModelExprNode<ModelVarNode>
+{
+    using ModelExprNode::operator=;
+    static const size_t length = 1;
+    const ModelColumn* column;
+
+    ModelVarNode(const ModelVar& var) : column(var.column.get()) {
+        if (!column)
+            throw std::invalid_argument("var");
+    }
+
+    template <typename F> void each(double m, F& f) const { f(column->ref, column->model, m); }
+    double constant(double) const { return 0.0; }
+    OptimizationModel* model() const { return column->model; }
+};
+
+template <typename E>
+struct ModelScaledNode : ModelExprNode<ModelScaledNode<E>>
+{
+    using ModelExprNode<ModelScaledNode<E>>::operator=;
+    static const size_t length = E::length;
+    E expr;
+    double scale;
+
+    ModelScaledNode(const E& expr, double scale) : expr(expr), scale(scale) {}
+
+    template <typename F> void each(double m, F& f) const { expr.visit(m * scale, f); }
+    double constant(double m) const { return expr.offset(m * scale); }
+    OptimizationModel* model() const { return expr.owner(); }
+};
+
+template <typename L, typename R>
+struct ModelSumNode : ModelExprNode<ModelSumNode<L, R>>
+{
+    using ModelExprNode<ModelSumNode<L, R>>::operator=;
+    static const size_t length = L::length + R::length;
+    L left;
+    R right;
+
+    ModelSumNode(const L& left, const R& right) : left(left), right(right) {}
+
+    template <typename F> void each(double m, F& f) const { left.visit(m, f); right.visit(m, f); }
+    double constant(double m) const { return left.offset(m) + right.offset(m); }
+    OptimizationModel* model() const { return left.owner() ? left.owner() : right.owner(); }
+};
+
+/// <summary>
+/// An expression compared with a constant, as built by x + y <= 3. Keeps the expression's
+/// constant apart from the right hand side, like ModelLinearExpression's comparisons.
+/// </summary>
+template <typename E>
+struct ModelCompareNode
+{
+    E expr;
+    ModelLinearExpression::Inequality type;
+    double rhs;
+
+    double lhs = 0.0;
+
+    ModelCompareNode(const E& expr, ModelLinearExpression::Inequality type, double rhs) : expr(expr), type(type), rhs(rhs) {}
+
+    // a bound on the other side makes it a range, 1 <= x + y <= 3
+    ModelCompareNode operator<=(double hi) const { return range(ModelLinearExpression::Inequality::GE, rhs, hi); }
+    ModelCompareNode operator>=(double lo) const { return range(ModelLinearExpression::Inequality::LE, lo, rhs); }
+
+    ModelCompareNode range(ModelLinearExpression::Inequality from, double lo, double hi) const {
+        if (type != from)
+            throw std::runtime_error("Inequality already specified");
+
+        ModelCompareNode result(expr, ModelLinearExpression::Inequality::Range, hi);
+        result.lhs = lo;
+        return result;
+    }
+
+    void evaluate(ModelLinearExpression& into) const {
+        into.append(expr, 1.0);
+        if (type == ModelLinearExpression::Inequality::Range) {
+            into.setInequality(ModelLinearExpression::Inequality::GE, lhs);
+            into.setInequality(ModelLinearExpression::Inequality::LE, rhs);
+        }
+        else {
+            into.setInequality(type, rhs);
+        }
+    }
+
+    operator ModelLinearExpression() const {
+        ModelLinearExpression result;
+        evaluate(result);
+        return result;
+    }
+};
+
+// operands of the node operators: variables, constants and nodes
+template <typename T, typename = void> struct ModelNodeOf {};
+template <> struct ModelNodeOf<ModelVar> { using type = ModelVarNode; };
+template <typename T> struct ModelNodeOf<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> { using type = ModelConstNode; };
+template <typename T> struct ModelNodeOf<T, typename std::enable_if<std::is_base_of<ModelExprTag, T>::value>::type> { using type = T; };
+
+template <typename T> using ModelNode = typename ModelNodeOf<T>::type;
+
+// at least one side is a variable or node, the other one may be a constant
+template <typename L, typename R>
+using ModelEnableSum = typename std::enable_if<!std::is_arithmetic<L>::value || !std::is_arithmetic<R>::value,
+    ModelSumNode<ModelNode<L>, ModelNode<R>>>::type;
+
+// exactly one side is a constant
+template <typename E, typename A>
+using ModelEnableScale = typename std::enable_if<std::is_arithmetic<A>::value && !std::is_arithmetic<E>::value,
+    ModelScaledNode<ModelNode<E>>>::type;
+
+template <typename E, typename A>
+using ModelEnableCompare = typename std::enable_if<std::is_arithmetic<A>::value && !std::is_arithmetic<E>::value,
+    ModelCompareNode<ModelNode<E>>>::type;
+
+template <typename L, typename R>
+ModelEnableSum<L, R> operator+(const L& l, const R& r) { return { ModelNode<L>(l), ModelNode<R>(r) }; }
+
+template <typename L, typename R>
+ModelEnableSum<L, ModelScaledNode<ModelNode<R>>> operator-(const L& l, const R& r) { return { ModelNode<L>(l), ModelScaledNode<ModelNode<R>>(ModelNode<R>(r), -1.0) }; }
+
+template <typename E>
+ModelEnableScale<E, double> operator-(const E& e) { return { ModelNode<E>(e), -1.0 }; }
+
+template <typename E>
+ModelEnableScale<E, double> operator+(const E& e) { return { ModelNode<E>(e), 1.0 }; }
+
+template <typename A, typename E>
+ModelEnableScale<E, A> operator*(A a, const E& e) { return { ModelNode<E>(e), (double)a }; }
+
+template <typename E, typename A>
+ModelEnableScale<E, A> operator*(const E& e, A a) { return { ModelNode<E>(e), (double)a }; }
+
+template <typename E, typename A>
+ModelEnableScale<E, A> operator/(const E& e, A a) { return { ModelNode<E>(e), 1.0 / a }; }
+
+template <typename E, typename A>
+ModelEnableCompare<E, A> operator==(const E& e, A rhs) { return { ModelNode<E>(e), ModelLinearExpression::Inequality::EQ, (double)rhs }; }
+
+template <typename E, typename A>
+ModelEnableCompare<E, A> operator<=(const E& e, A rhs) { return { ModelNode<E>(e), ModelLinearExpression::Inequality::LE, (double)rhs }; }
+
+template <typename E, typename A>
+ModelEnableCompare<E, A> operator>=(const E& e, A rhs) { return { ModelNode<E>(e), ModelLinearExpression::Inequality::GE, (double)rhs }; }
+
+template <typename A, typename E>
+ModelEnableCompare<E, A> operator==(A rhs, const E& e) { return { ModelNode<E>(e), ModelLinearExpression::Inequality::EQ, (double)rhs }; }
+
+template <typename A, typename E>
+ModelEnableCompare<E, A> operator<=(A rhs, const E& e) { return { ModelNode<E>(e), ModelLinearExpression::Inequality::GE, (double)rhs }; }
+
+template <typename A, typename E>
+ModelEnableCompare<E, A> operator>=(A rhs, const E& e) { return { ModelNode<E>(e), ModelLinearExpression::Inequality::LE, (double)rhs }; }
+
+template <typename Node, typename = typename std::enable_if<std::is_base_of<ModelExprTag, Node>::value>::type>
+std::ostream& operator<<(std::ostream& stream, const Node& node) { return stream << ModelLinearExpression(node); }
+
+template <typename Node>
+ModelExprNode<Node>::operator ModelLinearExpression() const
+{
+    if (built)
+        return *built;
+
+    ModelLinearExpression result;
+    result.append(static_cast<const Node&>(*this), 1.0);
+    return result;
+}
+
+template <typename Node>
+template <typename F>
+void ModelExprNode<Node>::visit(double m, F& f) const
+{
+    if (!built) {
+        static_cast<const Node&>(*this).each(m, f);
+        return;
+    }
+
+    // by index, the node may be appended to its own expression
+    size_t n = built->terms.size();
+    for (size_t i = 0; i < n; ++i)
+        f(built->terms[i].var, built->model, m * built->terms[i].coeff);
+}
+
+template <typename Node>
+ModelLinearExpression& ModelExprNode<Node>::expression() const
+{
+    // materialising doesn't change the expression the node stands for
+    if (!built)
+        const_cast<ModelExprNode*>(this)->built.reset(new ModelLinearExpression(static_cast<const Node&>(*this)));
+
+    return *built;
+}
+
+template <typename E>
+void ModelLinearExpression::append(const E& e, double m)
+{
+    grow(e.count());
+
+    auto add = [this](ModelVarRef ref, OptimizationModel* model, double coeff) {
+        setModel(model);
+        terms.push_back({ ref, coeff });
+    };
+
+    e.visit(m, add);
+    constant += e.offset(m);
+}
@@ -1,65 +1,77 @@
 #include "var.h"
 #include "constraint.h"
 #include "linear_expression.h"
+#include "optimization_model.h"
+#include "parallel.h"
 
 ModelLinearExpression::ModelLinearExpression(double xconstant)
 {
 	constant = xconstant;
+	lhs = 0.0;
 	rhs = 0.0;
 	type = Inequality::Unknown;
+	model = nullptr;
+}
+
+ModelLinearExpression::ModelLinearExpression(ModelArena& arena) : terms(ArenaAllocator<ModelTerm>(&arena))
+{
+	constant = 0.0;
+	lhs = 0.0;
+	rhs = 0.0;
+	type = Inequality::Unknown;
+	model = nullptr;
 }
 
 ModelLinearExpression::ModelLinearExpression(ModelVar var, double coeff)
 {
+	if (!var.column)
+		throw std::invalid_argument("var");
+
 	constant = 0.0;
+	lhs = 0.0;
 	rhs = 0.0;
 	type = Inequality::Unknown;
-	coeffs.push_back(coeff);
-	vars.push_back(var);
+	model = var.column->model;
+	terms.push_back({ var.column->ref, coeff });
 }
 
-ModelLinearExpression ModelLinearExpression::operator=(const ModelLinearExpression& rhs)
+void ModelLinearExpression::setModel(OptimizationModel* m)
 {
-	constant = rhs.constant;
-	this->rhs = rhs.rhs;
-	coeffs = rhs.coeffs;
-	vars = rhs.vars;
-	type = rhs.type;
+	if (m == nullptr || m == model)
+		return;
+
+	if (model != nullptr && !terms.empty())
+		throw std::invalid_argument("variables belong to different models");
+
+	model = m;
+}
 
-	return *this;
+// room for n more terms; grows geometrically, so a loop of += stays linear
+void ModelLinearExpression::grow(size_t n)
+{
+	if (terms.capacity() - terms.size() < n)
+		terms.reserve(std::max(terms.size() + n, 2 * terms.capacity()));
 }
 
 void ModelLinearExpression::multAdd(double m, const ModelLinearExpression& expr)
 {
 	if (m == 0) return;
 
-	ModelLinearExpression tmp;
-	const vector<double>* addcoeffs;
-	const vector<ModelVar>* addvars;
+	setModel(expr.model);
 
-	/* to avoid an endless loop when adding an expression to itself, we copy
-	 * the expr and use the data inside the copy */
-	if (&this->coeffs == &expr.coeffs) {
-		tmp = expr;
-		addcoeffs = &(tmp.coeffs);
-		addvars = &(tmp.vars);
-	}
-	else {
-		addcoeffs = &(expr.coeffs);
-		addvars = &(expr.vars);
-	}
+	/* to avoid an endless loop when adding an expression to itself, remember
+	 * the size up front and read the terms by index */
+	unsigned int size = expr.terms.size();
+	grow(size);
 
 	if (m == 1.0) {
-		coeffs.insert(coeffs.end(), addcoeffs->begin(), addcoeffs->end());
+		for (unsigned int i = 0; i < size; i++)
+			terms.push_back(expr.terms[i]);
 	}
 	else {
-		unsigned int size = (*addcoeffs).size();
-
-		for (unsigned int i = 0; i < size; i++) {
-			coeffs.push_back(m * (*addcoeffs)[i]);
-		}
+		for (unsigned int i = 0; i < size; i++)
+			terms.push_back({ expr.terms[i].var, m * expr.terms[i].coeff });
 	}
-	vars.insert(vars.end(), addvars->begin(), addvars->end());
 	constant += m * expr.constant;
 }
 
@@ -68,106 +80,227 @@ void ModelLinearExpression::operator+=(const ModelLinearExpression& expr)
 	this->multAdd(1.0, expr);
 }
 
+void ModelLinearExpression::operator+=(ModelLinearExpression&& expr)
+{
+	// an empty expression takes over the buffer of the temporary, if both use the same storage;
+	// one that reserved space keeps it and appends, e.g. quicksum(count, gen)
+	if (terms.empty() && terms.capacity() == 0 && terms.get_allocator() == expr.terms.get_allocator()) {
+		setModel(expr.model);
+		terms.swap(expr.terms);
+		constant += expr.constant;
+		return;
+	}
+
+	this->multAdd(1.0, expr);
+}
+
+void ModelLinearExpression::operator+=(ModelVar var)
+{
+	if (!var.column)
+		throw std::invalid_argument("var");
+
+	setModel(var.column->model);
+	terms.push_back({ var.column->ref, 1.0 });
+}
+
 void ModelLinearExpression::operator-=(const ModelLinearExpression& expr)
 {
 	this->multAdd(-1.0, expr);
 }
 
+void ModelLinearExpression::operator-=(ModelVar var)
+{
+	if (!var.column)
+		throw std::invalid_argument("var");
+
+	setModel(var.column->model);
+	terms.push_back({ var.column->ref, -1.0 });
+}
+
 void ModelLinearExpression::operator*=(double mult)
 {
 	constant *= mult;
-	for (unsigned int i = 0; i < vars.size(); i++) {
-		coeffs[i] *= mult;
+	for (auto& term : terms) {
+		term.coeff *= mult;
 	}
 }
 
 void ModelLinearExpression::operator/=(double a)
 {
 	constant /= a;
-	for (unsigned int i = 0; i < vars.size(); i++) {
-		coeffs[i] /= a;
+	for (auto& term : terms) {
+		term.coeff /= a;
 	}
 }
 
-ModelLinearExpression ModelLinearExpression::operator+(const ModelLinearExpression& rhs)
-{
-	ModelLinearExpression result = *this;
-	result.multAdd(1.0, rhs);
-	return result;
-}
-
-ModelLinearExpression ModelLinearExpression::operator-(const ModelLinearExpression& rhs)
-{
-	ModelLinearExpression result = *this;
-	result.multAdd(-1.0, rhs);
-	return result;
-}
-
 unsigned int ModelLinearExpression::size() const
 {
-	return vars.size();
+	return terms.size();
 }
 
 ModelVar ModelLinearExpression::getVar(int i) const
 {
-	return vars[i];
+	HighsInt col = model->colIndex(terms[i].var);
+	return col >= 0 ? model->getVar(col) : ModelVar();
 }
 
 double ModelLinearExpression::getCoeff(int i) const
 {
-	return coeffs[i];
-}
-
-//double ModelLinearExpression::getValue() const
-//{
-//	double value = constant;
-//	for (unsigned int i = 0; i < vars.size(); i++)
-//		value += coeffs[i] * vars[i].getValue();
-//	return value;
-//}
+	return terms[i].coeff;
+}
+
+void ModelLinearExpression::addTerms(const double* coeff, const ModelVar* var, size_t cnt, int threads)
+{
+	if (cnt == 0) return;
+
+	// chunks report their model and any error instead of throwing on a worker:
+	// 1 for a null variable, 2 for variables of different models
+	int chunks = parallelChunks(cnt, threads);
+	std::vector<OptimizationModel*> owner(chunks, nullptr);
+	std::vector<char> error(chunks, 0);
+
+	size_t offset = terms.size();
+	terms.resize(offset + cnt);
+	ModelTerm* out = terms.data() + offset;
+
+	parallelFor(cnt, chunks, [&](long long begin, long long end, int chunk) {
+		for (long long i = begin; i < end; i++) {
+			const ModelColumn* column = var[i].column.get();
+			if (!column) {
+				error[chunk] = 1;
+				return;
+			}
+			if (column->model != owner[chunk]) {
+				if (owner[chunk] != nullptr) {
+					error[chunk] = 2;
+					return;
+				}
+				owner[chunk] = column->model;
+			}
+			out[i] = { column->ref, coeff == NULL ? 1.0 : coeff[i] };
+		}
+	});
+
+	OptimizationModel* m = owner[0];
+	for (int chunk = 0; chunk < chunks; chunk++) {
+		if (error[chunk] || owner[chunk] != m) {
+			terms.resize(offset);
+			if (error[chunk] == 1)
+				throw std::invalid_argument("var");
+			throw std::invalid_argument("variables belong to different models");
+		}
+	}
 
-void ModelLinearExpression::addTerms(const double* coeff, const ModelVar* var, int   cnt)
-{
-	for (int i = 0; i < cnt; i++) {
-		if (coeff == NULL) coeffs.push_back(1.0);
-		else               coeffs.push_back(coeff[i]);
-		vars.push_back(var[i]);
+	if (model != nullptr && model != m && offset > 0) {
+		terms.resize(offset);
+		throw std::invalid_argument("variables belong to different models");
 	}
+	model = m;
 }
 
 void ModelLinearExpression::remove(int i)
 {
-	if (i < 0 || i >= (int)vars.size()) 
+	if (i < 0 || i >= (int)terms.size()) 
 		throw std::invalid_argument("i");
 
-	coeffs.erase(coeffs.begin() + i);
-	vars.erase(vars.begin() + i);
+	terms.erase(terms.begin() + i);
 }
 
 bool ModelLinearExpression::remove(ModelVar v)
 {
-	int size = (int)vars.size();
-	for (int i = size - 1; i >= 0; i--) {
-		if (v.column == vars[i].column) {
-			coeffs.erase(coeffs.begin() + i);
-			vars.erase(vars.begin() + i);
+	if (!v.column)
+		return false;
+
+	size_t size = terms.size();
+	ModelVarRef ref = v.column->ref;
+	terms.erase(std::remove_if(terms.begin(), terms.end(), [&](const ModelTerm& t) { return t.var == ref; }), terms.end());
+	return size > terms.size();
+}
+
+// drops terms whose variable has been removed from its model
+void ModelLinearExpression::dropRemovedVars()
+{
+	if (model == nullptr)
+		return;
+
+	terms.erase(std::remove_if(terms.begin(), terms.end(), [&](const ModelTerm& t) { return model->colIndex(t.var) < 0; }), terms.end());
+}
+
+/// <summary>
+/// Sum the coefficients of repeated variables into their first occurrence and drop
+/// near-zero and removed terms. Short expressions are merged in place, longer ones in
+/// O(terms) using a per-thread accumulator indexed by column slot, which only grows with
+/// the number of columns and is reset via the touched terms, so repeated calls don't allocate.
+/// </summary>
+void ModelLinearExpression::compress(double tolerance)
+{
+	thread_local std::vector<HighsInt> position;
+	compress(tolerance, position);
+}
+
+/// <summary>
+/// compress() with the caller's accumulator, all -1 between calls. update() keeps one per
+/// chunk of rows, so its worker threads don't build a new one on every update.
+/// </summary>
+void ModelLinearExpression::compress(double tolerance, std::vector<HighsInt>& position)
+{
+	if (model == nullptr)
+		return;
+
+	const size_t short_terms = 32;
+
+	bool dense = terms.size() > short_terms;
+	if (dense && position.size() < model->col_slots.size())
+		position.resize(model->col_slots.size(), -1);
+
+	size_t count = 0;
+	for (size_t i = 0; i < terms.size(); i++) {
+		const ModelTerm term = terms[i];
+		if (model->colIndex(term.var) < 0)
+			continue;
+
+		HighsInt p = -1;
+		if (dense) {
+			p = position[term.var.id];
+			if (p < 0)
+				position[term.var.id] = count;
+		}
+		else {
+			for (size_t j = 0; j < count && p < 0; j++)
+				if (terms[j].var.id == term.var.id)
+					p = j;
 		}
+
+		if (p < 0)
+			terms[count++] = term;
+		else
+			terms[p].coeff += term.coeff;
 	}
-	if (size > (int)vars.size()) return true;
-	else                          return false;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (dense)
+			position[terms[i].var.id] = -1;
+
+		if (std::fabs(terms[i].coeff) > tolerance)
+			terms[kept++] = terms[i];
+	}
+
+	terms.resize(kept);
 }
 
 void ModelLinearExpression::clear(void)
 {
 	constant = 0.0;
-	coeffs.clear();
-	vars.clear();
+	terms.clear();
 }
 
 std::ostream& operator<<(std::ostream& stream, ModelLinearExpression expr)
 {
-	for (unsigned int i = 0; i < expr.coeffs.size(); i++)
-		stream << "+ " << expr.coeffs[i] << " " << expr.vars[i].getName() << " ";
+	for (unsigned int i = 0; i < expr.terms.size(); i++) {
+		ModelVar var = expr.getVar(i);
+		stream << "+ " << expr.terms[i].coeff << " " << (var.index() >= 0 ? var.getName() : "?") << " ";
+	}
 	if (expr.constant != 0)
 		stream << "+ " << expr.constant;
 
@@ -194,54 +327,6 @@ ModelLinearExpression operator+(const ModelLinearExpression& x)
 	return result;
 }
 
-ModelLinearExpression operator+(ModelVar x, ModelVar y)
-{
-	ModelLinearExpression result(x);
-	result += y;
-
-	return result;
-}
-
-ModelLinearExpression operator+(ModelVar x, double a)
-{
-	ModelLinearExpression result(x);
-	result += a;
-
-	return result;
-}
-
-ModelLinearExpression operator+(double a, ModelVar x)
-{
-	ModelLinearExpression result(x);
-	result += a;
-
-	return result;
-}
-
-ModelLinearExpression operator-(ModelVar x, ModelVar y)
-{
-	ModelLinearExpression result(x);
-	result -= y;
-
-	return result;
-}
-
-ModelLinearExpression operator-(ModelVar x, double a)
-{
-	ModelLinearExpression result(x);
-	result -= a;
-
-	return result;
-}
-
-ModelLinearExpression operator-(double a, ModelVar x)
-{
-	ModelLinearExpression result(a);
-	result -= x;
-
-	return result;
-}
-
 ModelLinearExpression operator-(const ModelLinearExpression& x)
 {
 	ModelLinearExpression result;
@@ -250,21 +335,6 @@ ModelLinearExpression operator-(const ModelLinearExpression& x)
 	return result;
 }
 
-ModelLinearExpression operator*(double a, ModelVar x)
-{
-	return ModelLinearExpression(x, a);
-}
-
-ModelLinearExpression operator-(ModelVar x)
-{
-	return -1.0 * x;
-}
-
-ModelLinearExpression operator*(ModelVar x, double a)
-{
-	return ModelLinearExpression(x, a);
-}
-
 ModelLinearExpression operator*(const ModelLinearExpression& x, double a)
 {
 	ModelLinearExpression result = 0;
@@ -279,10 +349,6 @@ ModelLinearExpression operator*(double a, const ModelLinearExpression& x)
 	return result;
 }
 
-ModelLinearExpression operator/(ModelVar x, double a) {
-	return ModelLinearExpression(x, 1.0 / a);
-}
-
 ModelLinearExpression operator/(const ModelLinearExpression& x, double a) {
 	ModelLinearExpression result = x;
 	return (1.0 / a) * result;
@@ -324,84 +390,165 @@ ModelLinearExpression operator>=(double rhs, const ModelLinearExpression& that)
 }
 
 
-ModelLinearExpression operator==(double rhs, ModelVar x)
+
+ModelLinearExpression operator+(ModelLinearExpression&& x, const ModelLinearExpression& y)
 {
-	ModelLinearExpression result(x);
-	result.rhs = rhs;
-	result.type = ModelLinearExpression::Inequality::EQ;
-	return result;
+	x += y;
+	return std::move(x);
 }
 
-ModelLinearExpression operator<=(double rhs, ModelVar x)
+ModelLinearExpression operator+(const ModelLinearExpression& x, ModelLinearExpression&& y)
 {
-	ModelLinearExpression result(x);
-	result.rhs = rhs;
-	result.type = ModelLinearExpression::Inequality::GE;
-	return result;
+	y += x;
+	return std::move(y);
 }
 
-ModelLinearExpression operator>=(double rhs, ModelVar x)
+ModelLinearExpression operator+(ModelLinearExpression&& x, ModelLinearExpression&& y)
 {
-	ModelLinearExpression result(x);
-	result.rhs = rhs;
-	result.type = ModelLinearExpression::Inequality::LE;
-	return result;
+	x += std::move(y);
+	return std::move(x);
 }
 
+ModelLinearExpression operator+(ModelLinearExpression&& x, ModelVar y)
+{
+	x += y;
+	return std::move(x);
+}
 
-ModelLinearExpression operator==(ModelVar x, double rhs)
+ModelLinearExpression operator+(ModelLinearExpression&& x)
 {
-	ModelLinearExpression result(x);
-	result.rhs = rhs;
-	result.type = ModelLinearExpression::Inequality::EQ;
-	return result;
+	return std::move(x);
 }
 
-ModelLinearExpression operator<=(ModelVar x, double rhs)
+ModelLinearExpression operator-(ModelLinearExpression&& x, const ModelLinearExpression& y)
 {
-	ModelLinearExpression result(x);
-	result.rhs = rhs;
-	result.type = ModelLinearExpression::Inequality::LE;
-	return result;
+	x -= y;
+	return std::move(x);
 }
 
-ModelLinearExpression operator>=(ModelVar x, double rhs)
+ModelLinearExpression operator-(const ModelLinearExpression& x, ModelLinearExpression&& y)
 {
-	ModelLinearExpression result(x);
-	result.rhs = rhs;
-	result.type = ModelLinearExpression::Inequality::GE;
-	return result;
+	y *= -1.0;
+	y += x;
+	return std::move(y);
 }
 
-ModelLinearExpression quicksum(const std::vector<ModelVar> vars) {
-	ModelLinearExpression expr;
+ModelLinearExpression operator-(ModelLinearExpression&& x, ModelLinearExpression&& y)
+{
+	x -= y;
+	return std::move(x);
+}
 
-	for (auto var : vars) {
-		expr += var;
-	}
+ModelLinearExpression operator-(ModelLinearExpression&& x, ModelVar y)
+{
+	x -= y;
+	return std::move(x);
+}
 
-	return expr;
+ModelLinearExpression operator-(ModelLinearExpression&& x)
+{
+	x *= -1.0;
+	return std::move(x);
+}
+
+ModelLinearExpression operator*(ModelLinearExpression&& x, double a)
+{
+	if (a == 0.0)
+		x.clear();
+	else
+		x *= a;
+
+	return std::move(x);
+}
+
+ModelLinearExpression operator*(double a, ModelLinearExpression&& x)
+{
+	return std::move(x) * a;
+}
+
+ModelLinearExpression operator/(ModelLinearExpression&& x, double a)
+{
+	x /= a;
+	return std::move(x);
+}
+
+ModelLinearExpression operator==(double rhs, ModelLinearExpression&& that)
+{
+	if (that.type != ModelLinearExpression::Inequality::Unknown)
+		throw std::invalid_argument("Inequality already set");
+
+	that.rhs = rhs;
+	that.type = ModelLinearExpression::Inequality::EQ;
+	return std::move(that);
+}
+
+ModelLinearExpression operator<=(double rhs, ModelLinearExpression&& that)
+{
+	if (that.type != ModelLinearExpression::Inequality::Unknown)
+		throw std::invalid_argument("Inequality already set");
+
+	that.rhs = rhs;
+	that.type = ModelLinearExpression::Inequality::GE;
+	return std::move(that);
+}
+
+ModelLinearExpression operator>=(double rhs, ModelLinearExpression&& that)
+{
+	if (that.type != ModelLinearExpression::Inequality::Unknown)
+		throw std::invalid_argument("Inequality already set");
+
+	that.rhs = rhs;
+	that.type = ModelLinearExpression::Inequality::LE;
+	return std::move(that);
+}
+
+ModelLinearExpression quicksum(const std::vector<ModelVar>& vars, int threads) {
+	return quicksum(vars.data(), vars.size(), threads);
 }
 
-ModelLinearExpression quicksum(const std::vector<ModelLinearExpression> vars) {
+ModelLinearExpression quicksum(const ModelVar* vars, size_t count, int threads) {
 	ModelLinearExpression expr;
+	expr.addTerms(nullptr, vars, count, threads);
+	return expr;
+}
 
-	for (auto var : vars) {
-		expr += var;
-	}
+ModelLinearExpression quicksum(const std::vector<double>& coeffs, const std::vector<ModelVar>& vars, int threads) {
+	if (coeffs.size() != vars.size())
+		throw std::invalid_argument("coeffs");
+
+	return quicksum(coeffs.data(), vars.data(), vars.size(), threads);
+}
 
+ModelLinearExpression quicksum(const double* coeffs, const ModelVar* vars, size_t count, int threads) {
+	ModelLinearExpression expr;
+	expr.addTerms(coeffs, vars, count, threads);
 	return expr;
 }
 
-// takes a lambda predicate to conditionally sum over a vector of variables
-ModelLinearExpression quicksum_if(const std::vector<ModelVar>& vars, std::function<bool(ModelVar)> pred) {
+ModelLinearExpression quicksum(const std::vector<ModelLinearExpression>& exprs, int threads) {
 	ModelLinearExpression expr;
 
-	for (auto var : vars) {
-		if (pred(var)) {
-			expr += var;
-		}
+	// where each sub-expression's terms go in the result; the constants and the model are
+	// settled here, so the parallel pass only copies terms
+	std::vector<size_t> offset(exprs.size() + 1, 0);
+	for (size_t i = 0; i < exprs.size(); i++) {
+		const ModelLinearExpression& e = exprs[i];
+		offset[i + 1] = offset[i] + e.terms.size();
+		expr.constant += e.constant;
+
+		if (e.terms.empty()) continue;
+		if (expr.model != nullptr && expr.model != e.model)
+			throw std::invalid_argument("variables belong to different models");
+		expr.model = e.model;
 	}
 
+	expr.terms.resize(offset.back());
+	ModelTerm* out = expr.terms.data();
+
+	parallelFor(exprs.size(), parallelChunks(offset.back(), threads), [&](long long begin, long long end, int) {
+		for (long long i = begin; i < end; i++)
+			std::copy(exprs[i].terms.begin(), exprs[i].terms.end(), out + offset[i]);
+	});
+
 	return expr;
-}
\ No newline at end of file
+}
@@ -1,134 +1,228 @@
 #pragma once
+#include <iterator>
+#include <type_traits>
+#include "arena.h"
+
+class OptimizationModel;
+
+// base of the expression template nodes, see expression_template.h
+struct ModelExprTag {};
+template <typename Node> struct ModelExprNode;
+template <typename E> struct ModelCompareNode;
 
 class ModelLinearExpression
 {
-private:
-    double constant, rhs;
+public:
+    // Range is lhs <= expr <= rhs, built by comparing on both sides: lo <= expr <= hi
+    enum class Inequality { Unknown, EQ, LE, GE, Range };
 
-    enum class Inequality { Unknown, EQ, LE, GE };
+private:
+    double constant, lhs, rhs;
     Inequality type;
 
-    std::vector<double> coeffs;
-    std::vector<ModelVar> vars;
-    void multAdd(double m, const ModelLinearExpression& expr);
+    // terms refer to columns of this model, null until the first variable is added
+    OptimizationModel* model;
+    std::vector<ModelTerm, ArenaAllocator<ModelTerm>> terms;
 
-  public:
-    friend class OptimizationModel;
+    // expression of a model row, its terms live in the model's arena
+    ModelLinearExpression(ModelArena& arena);
 
-    ModelLinearExpression(double constant=0.0);
-    ModelLinearExpression(ModelVar var, double coeff=1.0);
-
-    ModelLinearExpression operator==(double rhs)
+    void setModel(OptimizationModel* m);
+    void compress(double tolerance, std::vector<HighsInt>& position);
+    void grow(size_t n);
+    void multAdd(double m, const ModelLinearExpression& expr);
+    void dropRemovedVars();
+    template <typename E> void append(const E& e, double m);
+    void setInequality(Inequality t, double rhs)
     {
+        // a bound on the other side of a one-sided comparison makes it a range
+        if (type == Inequality::GE && t == Inequality::LE) {
+            lhs = this->rhs;
+            this->rhs = rhs;
+            type = Inequality::Range;
+            return;
+        }
+        if (type == Inequality::LE && t == Inequality::GE) {
+            lhs = rhs;
+            type = Inequality::Range;
+            return;
+        }
+
         if (type != Inequality::Unknown)
             throw std::runtime_error("Inequality already specified");
 
         this->rhs = rhs;
-        type = Inequality::EQ;
-        return *this;
+        type = t;
     }
 
-    ModelLinearExpression operator<= (double rhs)
-    {
-        if (type != Inequality::Unknown)
-            throw std::runtime_error("Inequality already specified");
+  public:
+    friend class OptimizationModel;
+    friend class ModelRow;
+    template <typename Node> friend struct ModelExprNode;
+    template <typename E> friend struct ModelCompareNode;
+    friend ModelLinearExpression quicksum(const std::vector<ModelLinearExpression>& exprs, int threads);
 
-        this->rhs = rhs;
-        type = Inequality::LE;
-        return *this;
-    }
+    ModelLinearExpression(double constant=0.0);
+    ModelLinearExpression(ModelVar var, double coeff=1.0);
+    ModelLinearExpression(const ModelLinearExpression& expr) = default;
+    ModelLinearExpression(ModelLinearExpression&& expr) = default;
 
-    ModelLinearExpression operator>= (double rhs)
-    {
-        if (type != Inequality::Unknown)
-            throw std::runtime_error("Inequality already specified");
+    ModelLinearExpression operator==(double rhs) &  { setInequality(Inequality::EQ, rhs); return *this; }
+    ModelLinearExpression operator<=(double rhs) &  { setInequality(Inequality::LE, rhs); return *this; }
+    ModelLinearExpression operator>=(double rhs) &  { setInequality(Inequality::GE, rhs); return *this; }
 
-        this->rhs = rhs;
-        type = Inequality::GE;
-        return *this;
-    }
+    // temporaries hand their terms on instead of copying them
+    ModelLinearExpression operator==(double rhs) && { setInequality(Inequality::EQ, rhs); return std::move(*this); }
+    ModelLinearExpression operator<=(double rhs) && { setInequality(Inequality::LE, rhs); return std::move(*this); }
+    ModelLinearExpression operator>=(double rhs) && { setInequality(Inequality::GE, rhs); return std::move(*this); }
 
     friend std::ostream& operator<<(std::ostream &stream, ModelLinearExpression expr);
     friend ModelLinearExpression operator+(const ModelLinearExpression& x, const ModelLinearExpression& y);
     friend ModelLinearExpression operator+(const ModelLinearExpression& x);
-    friend ModelLinearExpression operator+(ModelVar x, ModelVar y);
-    friend ModelLinearExpression operator+(ModelVar x, double a);
-    friend ModelLinearExpression operator+(double a, ModelVar x);
     friend ModelLinearExpression operator-(const ModelLinearExpression& x, const ModelLinearExpression& y);
     friend ModelLinearExpression operator-(const ModelLinearExpression& x);
-    friend ModelLinearExpression operator-(ModelVar x);
-    friend ModelLinearExpression operator-(ModelVar x, ModelVar y);
-    friend ModelLinearExpression operator-(ModelVar x, double a);
-    friend ModelLinearExpression operator-(double a, ModelVar x);
-    friend ModelLinearExpression operator*(double a, ModelVar x);
-    friend ModelLinearExpression operator*(ModelVar x, double a);
     friend ModelLinearExpression operator*(const ModelLinearExpression& x, double a);
     friend ModelLinearExpression operator*(double a, const ModelLinearExpression& x);
-    friend ModelLinearExpression operator/(ModelVar x, double a);
     friend ModelLinearExpression operator/(const ModelLinearExpression& x, double a);
 
     friend ModelLinearExpression operator==(double rhs, const ModelLinearExpression& that);
     friend ModelLinearExpression operator<=(double rhs, const ModelLinearExpression& that);
     friend ModelLinearExpression operator>=(double rhs, const ModelLinearExpression& that);
-    friend ModelLinearExpression operator==(double rhs, ModelVar x);
-    friend ModelLinearExpression operator<=(double rhs, ModelVar x);
-    friend ModelLinearExpression operator>=(double rhs, ModelVar x);
-    friend ModelLinearExpression operator==(ModelVar x, double rhs);
-    friend ModelLinearExpression operator<=(ModelVar x, double rhs);
-    friend ModelLinearExpression operator>=(ModelVar x, double rhs);
+
+    friend ModelLinearExpression operator+(ModelLinearExpression&& x, const ModelLinearExpression& y);
+    friend ModelLinearExpression operator+(const ModelLinearExpression& x, ModelLinearExpression&& y);
+    friend ModelLinearExpression operator+(ModelLinearExpression&& x, ModelLinearExpression&& y);
+    friend ModelLinearExpression operator+(ModelLinearExpression&& x, ModelVar y);
+    friend ModelLinearExpression operator+(ModelLinearExpression&& x);
+    friend ModelLinearExpression operator-(ModelLinearExpression&& x, const ModelLinearExpression& y);
+    friend ModelLinearExpression operator-(const ModelLinearExpression& x, ModelLinearExpression&& y);
+    friend ModelLinearExpression operator-(ModelLinearExpression&& x, ModelLinearExpression&& y);
+    friend ModelLinearExpression operator-(ModelLinearExpression&& x, ModelVar y);
+    friend ModelLinearExpression operator-(ModelLinearExpression&& x);
+    friend ModelLinearExpression operator*(ModelLinearExpression&& x, double a);
+    friend ModelLinearExpression operator*(double a, ModelLinearExpression&& x);
+    friend ModelLinearExpression operator/(ModelLinearExpression&& x, double a);
+    friend ModelLinearExpression operator==(double rhs, ModelLinearExpression&& that);
+    friend ModelLinearExpression operator<=(double rhs, ModelLinearExpression&& that);
+    friend ModelLinearExpression operator>=(double rhs, ModelLinearExpression&& that);
 
     unsigned int size(void) const;
     ModelVar getVar(int i) const;
     double getCoeff(int i) const;
     double getConstant() const { return constant; }
     double getRHS() const { return rhs; }
-    //double getValue() const;
-
-    void addTerms(const double* coeff, const ModelVar* var, int cnt);
-    ModelLinearExpression operator=(const ModelLinearExpression& rhs);
+    double getLHS() const { return lhs; }
+    Inequality getInequality() const { return type; }
+    double getValue() const;
+
+    // appends cnt terms at once; long arrays are filled by threads threads, 0 uses all hardware threads
+    void addTerms(const double* coeff, const ModelVar* var, size_t cnt, int threads = 1);
+    void reserve(size_t n) { terms.reserve(n); }
+    ModelLinearExpression& operator=(const ModelLinearExpression& rhs) = default;
+    ModelLinearExpression& operator=(ModelLinearExpression&& rhs) = default;
     void operator+=(const ModelLinearExpression& expr);
+    void operator+=(ModelLinearExpression&& expr);
+    void operator+=(ModelVar var);
     void operator-=(const ModelLinearExpression& expr);
+    void operator-=(ModelVar var);
+
+    // expression template nodes are appended without building an intermediate expression
+    template <typename E, typename = typename std::enable_if<std::is_base_of<ModelExprTag, E>::value>::type>
+    void operator+=(const E& e) { append(e, 1.0); }
+    template <typename E, typename = typename std::enable_if<std::is_base_of<ModelExprTag, E>::value>::type>
+    void operator-=(const E& e) { append(e, -1.0); }
     void operator*=(double mult);
     void operator/=(double a);
-    ModelLinearExpression operator+(const ModelLinearExpression& rhs);
-    ModelLinearExpression operator-(const ModelLinearExpression& rhs);
     void remove(int i);
     bool remove(ModelVar v);
 
+    // merge duplicate variables and drop terms with |coeff| <= tolerance
+    void compress(double tolerance = kHighsTiny);
+
     void clear();
 };
 
 //std::ostream& operator<<(std::ostream &stream, ModelLinearExpression expr);
 ModelLinearExpression operator+(const ModelLinearExpression& x, const ModelLinearExpression& y);
 ModelLinearExpression operator+(const ModelLinearExpression& x);
-ModelLinearExpression operator+(ModelVar x, ModelVar y);
-ModelLinearExpression operator+(ModelVar x, double a);
-ModelLinearExpression operator+(double a, ModelVar x);
 ModelLinearExpression operator-(const ModelLinearExpression& x, const ModelLinearExpression& y);
 ModelLinearExpression operator-(const ModelLinearExpression& x);
-ModelLinearExpression operator-(ModelVar x);
-ModelLinearExpression operator-(ModelVar x, ModelVar y);
-ModelLinearExpression operator-(ModelVar x, double a);
-ModelLinearExpression operator-(double a, ModelVar x);
-ModelLinearExpression operator*(double a, ModelVar x);
-ModelLinearExpression operator*(ModelVar x, double a);
 ModelLinearExpression operator*(const ModelLinearExpression& x, double a);
 ModelLinearExpression operator*(double a, const ModelLinearExpression& x);
-ModelLinearExpression operator/(ModelVar x, double a);
 ModelLinearExpression operator/(const ModelLinearExpression& x, double a);
 ModelLinearExpression operator==(double rhs, const ModelLinearExpression& that);
 ModelLinearExpression operator<=(double rhs, const ModelLinearExpression& that);
 ModelLinearExpression operator>=(double rhs, const ModelLinearExpression& that);
-ModelLinearExpression operator==(double rhs, ModelVar x);
-ModelLinearExpression operator<=(double rhs, ModelVar x);
-ModelLinearExpression operator>=(double rhs, ModelVar x);
-ModelLinearExpression operator==(ModelVar x, double rhs);
-ModelLinearExpression operator<=(ModelVar x, double rhs);
-ModelLinearExpression operator>=(ModelVar x, double rhs);
 
+// rvalue overloads reuse the buffer of a temporary, so operator chains don't copy
+ModelLinearExpression operator+(ModelLinearExpression&& x, const ModelLinearExpression& y);
+ModelLinearExpression operator+(const ModelLinearExpression& x, ModelLinearExpression&& y);
+ModelLinearExpression operator+(ModelLinearExpression&& x, ModelLinearExpression&& y);
+ModelLinearExpression operator+(ModelLinearExpression&& x, ModelVar y);
+ModelLinearExpression operator+(ModelLinearExpression&& x);
+ModelLinearExpression operator-(ModelLinearExpression&& x, const ModelLinearExpression& y);
+ModelLinearExpression operator-(const ModelLinearExpression& x, ModelLinearExpression&& y);
+ModelLinearExpression operator-(ModelLinearExpression&& x, ModelLinearExpression&& y);
+ModelLinearExpression operator-(ModelLinearExpression&& x, ModelVar y);
+ModelLinearExpression operator-(ModelLinearExpression&& x);
+ModelLinearExpression operator*(ModelLinearExpression&& x, double a);
+ModelLinearExpression operator*(double a, ModelLinearExpression&& x);
+ModelLinearExpression operator/(ModelLinearExpression&& x, double a);
+ModelLinearExpression operator==(double rhs, ModelLinearExpression&& that);
+ModelLinearExpression operator<=(double rhs, ModelLinearExpression&& that);
+ModelLinearExpression operator>=(double rhs, ModelLinearExpression&& that);
+
+
+// sums over arrays and (coeffs, vars) pairs size the result once; long ones are filled by
+// threads threads, 0 uses all hardware threads. Serial by default, so sums built inside
+// solveBatch or other parallel code don't start threads of their own
+ModelLinearExpression quicksum(const std::vector<ModelVar>& vars, int threads = 1);
+ModelLinearExpression quicksum(const ModelVar* vars, size_t count, int threads = 1);
+ModelLinearExpression quicksum(const std::vector<double>& coeffs, const std::vector<ModelVar>& vars, int threads = 1);
+ModelLinearExpression quicksum(const double* coeffs, const ModelVar* vars, size_t count, int threads = 1);
+
+// concatenates the terms of all sub-expressions, in parallel when threads != 1
+ModelLinearExpression quicksum(const std::vector<ModelLinearExpression>& exprs, int threads = 1);
+
+// sum over an iterator range of variables, expressions or expression template nodes
+template <typename It, typename Category = typename std::iterator_traits<It>::iterator_category>
+ModelLinearExpression quicksum(It first, It last)
+{
+    ModelLinearExpression expr;
+    if (std::is_base_of<std::forward_iterator_tag, Category>::value)
+        expr.reserve(std::distance(first, last));
+
+    for (; first != last; ++first)
+        expr += *first;
+
+    return expr;
+}
+
+// sum of gen(0) ... gen(count - 1), e.g. quicksum(n, [&](size_t i) { return c[i] * x[i]; })
+template <typename Gen>
+ModelLinearExpression quicksum(size_t count, Gen gen)
+{
+    ModelLinearExpression expr;
+    expr.reserve(count);
+
+    for (size_t i = 0; i < count; ++i)
+        expr += gen(i);
+
+    return expr;
+}
+
+// takes a predicate to conditionally sum over a vector of variables
+template <typename Pred>
+ModelLinearExpression quicksum_if(const std::vector<ModelVar>& vars, Pred pred)
+{
+    ModelLinearExpression expr;
+
+    for (const auto& var : vars) {
+        if (pred(var))
+            expr += var;
+    }
 
-ModelLinearExpression quicksum(const std::vector<ModelVar> vars);
-ModelLinearExpression quicksum(const std::vector<ModelLinearExpression> vars);
+    return expr;
+}
 
-// takes a lambda predicate to conditionally sum over a vector of variables
-ModelLinearExpression quicksum_if(const std::vector<ModelVar>& vars, std::function<bool(ModelVar)> pred);
\ No newline at end of file
+#include "expression_template.h"
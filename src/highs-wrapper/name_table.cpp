@@ -0,0 +1,118 @@
+#include <cstring>
+#include "name_table.h"
+
+uint64_t NameTable::hash(const char* str, size_t length)
+{
+	// FNV-1a
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < length; ++i) {
+		h ^= (unsigned char)str[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+void NameTable::Data::rehash(size_t size)
+{
+	lookup.assign(size, 0);
+	for (uint32_t id = 0; id < prefixes.size(); ++id) {
+		size_t slot = hash(buffer.data() + prefixes[id].offset, prefixes[id].length) & (size - 1);
+		while (lookup[slot] != 0)
+			slot = (slot + 1) & (size - 1);
+		lookup[slot] = id + 1;
+	}
+}
+
+/// <summary>
+/// Storage to change, copied first if another table still shares it.
+/// </summary>
+NameTable::Data& NameTable::write()
+{
+	if (data.use_count() > 1)
+		data = std::make_shared<Data>(*data);
+	return *data;
+}
+
+/// <summary>
+/// Id of the prefix, adding it to the buffer the first time it is seen.
+/// </summary>
+uint32_t NameTable::intern(const std::string& prefix)
+{
+	Data& w = write();
+	auto& buffer = w.buffer;
+	auto& prefixes = w.prefixes;
+	auto& lookup = w.lookup;
+
+	// keep the load factor at or below 1/2
+	if (2 * (prefixes.size() + 1) > lookup.size())
+		w.rehash(lookup.empty() ? 16 : 2 * lookup.size());
+
+	size_t mask = lookup.size() - 1;
+	size_t slot = hash(prefix.data(), prefix.size()) & mask;
+
+	while (lookup[slot] != 0) {
+		const Prefix& p = prefixes[lookup[slot] - 1];
+		if (p.length == prefix.size() && std::memcmp(buffer.data() + p.offset, prefix.data(), p.length) == 0)
+			return lookup[slot] - 1;
+		slot = (slot + 1) & mask;
+	}
+
+	uint32_t id = prefixes.size();
+	prefixes.push_back({ (uint32_t)buffer.size(), (uint32_t)prefix.size() });
+	buffer.append(prefix);
+	lookup[slot] = id + 1;
+	return id;
+}
+
+/// <summary>
+/// New name, stored as the interned text before a trailing decimal number and the number.
+/// Numbers with a leading zero or beyond int32_t stay part of the prefix, so get() gives
+/// back the name as it was added.
+/// </summary>
+uint32_t NameTable::add(const std::string& name)
+{
+	if (name.empty())
+		return none;
+
+	size_t digits = name.size();
+	while (digits > 0 && name[digits - 1] >= '0' && name[digits - 1] <= '9')
+		--digits;
+
+	size_t length = name.size() - digits;
+	bool number = length > 0 && length <= 9 && (name[digits] != '0' || length == 1);
+
+	if (!number)
+		return add(intern(name), -1);
+
+	return add(intern(name.substr(0, digits)), std::stoi(name.substr(digits)));
+}
+
+/// <summary>
+/// New name made of an interned prefix and a decimal suffix, or just the prefix when number < 0.
+/// </summary>
+uint32_t NameTable::add(uint32_t prefix, int32_t number)
+{
+	auto& entries = write().entries;
+	entries.push_back({ prefix, number });
+	return entries.size() - 1;
+}
+
+std::string NameTable::get(uint32_t id) const
+{
+	const Data& d = *data;
+	if (id == none || id >= d.entries.size())
+		return "";
+
+	const Prefix& p = d.prefixes[d.entries[id].prefix];
+	std::string name(d.buffer, p.offset, p.length);
+
+	if (d.entries[id].number >= 0)
+		name += std::to_string(d.entries[id].number);
+
+	return name;
+}
+
+void NameTable::clear()
+{
+	data = std::make_shared<Data>();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Compact storage for column or row names. Distinct prefixes are interned into one
+/// contiguous buffer, and each name is a prefix plus an optional decimal suffix, so
+/// "x0".."x999999" cost one prefix and 8 bytes per name. Strings are only built when
+/// a name is requested. Copies share the storage until one of them is changed.
+/// </summary>
+class NameTable
+{
+  private:
+    struct Prefix { uint32_t offset, length; };
+    struct Entry { uint32_t prefix; int32_t number; };
+
+    struct Data
+    {
+        std::string buffer;
+        std::vector<Prefix> prefixes;
+        std::vector<Entry> entries;
+
+        // open addressing hash of prefix ids (+1, 0 is empty) keyed on the prefix text
+        std::vector<uint32_t> lookup;
+
+        void rehash(size_t size);
+    };
+
+    std::shared_ptr<Data> data = std::make_shared<Data>();
+
+    static uint64_t hash(const char* str, size_t length);
+    Data& write();
+
+  public:
+    static const uint32_t none = UINT32_MAX;
+
+    uint32_t intern(const std::string& prefix);
+    // a trailing decimal number is split off, so "x0".."x999999" share the prefix "x"
+    uint32_t add(const std::string& name);
+    uint32_t add(uint32_t prefix, int32_t number);
+
+    std::string get(uint32_t id) const;
+    bool empty() const { return data->entries.empty(); }
+    void clear();
+};
@@ -1,201 +1,1404 @@
 #include <string.h>
 #include <assert.h>
 #include <cstdlib>
+#include <cmath>
 #include "optimization_model.h"
+#include "parallel.h"
 
 OptimizationModel::OptimizationModel(const string& filename)
 {
 	read(filename);
 }
 
-OptimizationModel::OptimizationModel(const OptimizationModel& m)
+/// <summary>
+/// Independent copy with its own highs, basis and handles. Rows already passed to highs
+/// are not mirrored again: the copy's highs holds them and its rows are adopted, so a copy
+/// costs one highs model instead of a second wrapper matrix. Names stay shared until either
+/// model adds one. Only reads m, so several threads may copy the same model at once.
+/// Handles of m map onto the copy by index, see getVar/getConstr.
+/// </summary>
+OptimizationModel::OptimizationModel(const OptimizationModel& m) :
+	col_slots(m.col_slots), free_col_slots(m.free_col_slots), col_names(m.col_names), row_names(m.row_names),
+	objective(m.objective), sense(m.sense), objective_in_highs(m.objective_in_highs),
+	synced_cols(m.synced_cols), synced_rows(m.synced_rows), synced(m.synced), objective_changed(m.objective_changed),
+	assembly_threads(m.assembly_threads), assembly_format(m.assembly_format),
+	removed_cols(m.removed_cols), removed_rows(m.removed_rows), streamed(m.streamed),
+	warm(m.warm), warm_start(m.warm_start), original(m.original)
+{
+	// the open row of a builder on m isn't part of the model
+	streamed.index.resize(streamed.start.back());
+	streamed.value.resize(streamed.start.back());
+
+	// expressions keep their slot ids, the slots are copied as they are
+	if (objective.model)
+		objective.model = this;
+
+	// lazy handles of m stay lazy
+	columns.resize(m.columns.size());
+	for (HighsInt c = 0; c < m.columns.size(); ++c) {
+		if (const auto& col = m.columns[c]) {
+			columns[c] = std::shared_ptr<ModelColumn>(arena, arena->create<ModelColumn>(this, col->col, col->ref, col->name));
+			columns[c]->lb = col->lb;
+			columns[c]->ub = col->ub;
+			columns[c]->integer = col->integer;
+		}
+	}
+
+	rows.resize(m.rows.size());
+	for (HighsInt r = 0; r < m.rows.size(); ++r) {
+		const auto& row = m.rows[r];
+		if (!row)
+			continue;
+
+		rows[r] = newRow(row->row, row->name);
+		ModelLinearExpression& expr = rows[r]->expr;
+
+		if (synced && r < synced_rows) {
+			rows[r]->adopted = true;
+			expr.constant = row->expr.constant;
+			expr.lhs = row->expr.lhs;
+			expr.rhs = row->expr.rhs;
+			expr.type = row->expr.type;
+		}
+		else {
+			rows[r]->adopted = row->adopted;
+			rows[r]->streamed = row->streamed;
+			expr = row->expr;
+			if (expr.model)
+				expr.model = this;
+		}
+	}
+
+	highs.passOptions(m.highs.getOptions());
+
+	if (synced) {
+		highs.passModel(m.highs.getLp());
+
+		if (m.highs.getBasis().valid)
+			highs.setBasis(m.highs.getBasis());
+
+		if (m.highs.getSolution().value_valid)
+			highs.setSolution(m.highs.getSolution());
+	}
+}
+
+/// <summary>
+/// Create the column at position col, reusing a free slot if there is one.
+/// </summary>
+std::shared_ptr<ModelColumn> OptimizationModel::newColumn(HighsInt col, uint32_t name)
+{
+	ModelVarRef ref;
+
+	if (!free_col_slots.empty()) {
+		ref.id = free_col_slots.back();
+		free_col_slots.pop_back();
+	}
+	else {
+		ref.id = col_slots.size();
+		col_slots.push_back({ -1, 0 });
+	}
+
+	col_slots[ref.id].col = col;
+	ref.gen = col_slots[ref.id].gen;
+
+	return std::shared_ptr<ModelColumn>(arena, arena->create<ModelColumn>(this, col, ref, name));
+}
+
+/// <summary>
+/// Create the row at position row, in the arena like its terms.
+/// </summary>
+std::shared_ptr<ModelRow> OptimizationModel::newRow(HighsInt row, uint32_t name)
+{
+	return std::shared_ptr<ModelRow>(arena, arena->create<ModelRow>(this, row, name, *arena));
+}
+
+/// <summary>
+/// Handle of column c. Columns that so far only exist in highs get their handle
+/// created here, on first access.
+/// </summary>
+const std::shared_ptr<ModelColumn>& OptimizationModel::column(HighsInt c) const
+{
+	if (!columns[c]) {
+		// materialising a handle doesn't change the model itself
+		OptimizationModel* self = const_cast<OptimizationModel*>(this);
+		const HighsLp& lp = highs.getLp();
+
+		auto col = self->newColumn(c);
+		col->lb = lp.col_lower_[c];
+		col->ub = lp.col_upper_[c];
+		col->integer = c < lp.integrality_.size() && lp.integrality_[c] == HighsVarType::kInteger;
+		self->columns[c] = std::move(col);
+	}
+
+	return columns[c];
+}
+
+const std::shared_ptr<ModelRow>& OptimizationModel::row(HighsInt r) const
+{
+	if (!rows[r]) {
+		OptimizationModel* self = const_cast<OptimizationModel*>(this);
+		self->rows[r] = self->newRow(r);
+		self->rows[r]->adopted = true;
+	}
+
+	return rows[r];
+}
+
+/// <summary>
+/// Adopt the model held by highs without mirroring it: columns and rows are only
+/// counted, their handles and the objective expression are created on demand.
+/// </summary>
+void OptimizationModel::viewHighs()
+{
+	row_matrix_valid = false;
+	columns.clear();
+	rows.clear();
+	col_slots.clear();
+	free_col_slots.clear();
+	col_names.clear();
+	row_names.clear();
+
+	columns.resize(highs.getNumCol());
+	rows.resize(highs.getNumRow());
+	removed_cols = removed_rows = 0;
+
+	objective.clear();
+	objective_in_highs = true;
+	warm = WarmStart();
+	++revision;
+	sense = highs.getLp().sense_;
+
+	synced = true;
+	synced_cols = columns.size();
+	synced_rows = rows.size();
+	objective_changed = false;
+}
+
+OptimizationModel::OptimizationModel(const HighsModel& m, OptimizationModel* original) : original(original)
+{
+	highs.passModel(m);
+	viewHighs();
+}
+
+void OptimizationModel::read(const string& filename)
+{
+	highs.readModel(filename);
+	viewHighs();
+}
+
+void OptimizationModel::write(const string& filename)
+{
+	update();
+	passNames();
+	highs.writeModel(filename);
+}
+
+void OptimizationModel::readSnapshot(const string& filename)
+{
+	HighsModel model;
+	HighsBasis basis;
+	readModelSnapshot(filename, model.lp_, basis);
+
+	highs.passModel(std::move(model));
+	viewHighs();
+
+	if (basis.valid)
+		highs.setBasis(basis);
+}
+
+void OptimizationModel::writeSnapshot(const string& filename, bool names, bool basis)
+{
+	update();
+
+	if (names)
+		passNames();
+
+	writeModelSnapshot(filename, highs.getLp(), names, basis ? &highs.getBasis() : nullptr);
+}
+
+/// <summary>
+/// Hand the names given through the wrapper to highs, they are only needed there for
+/// writing the model out.
+/// </summary>
+void OptimizationModel::passNames()
+{
+	for (const auto& col : columns)
+		if (col && col->name != NameTable::none)
+			highs.passColName(col->col, col_names.get(col->name));
+
+	for (const auto& row : rows)
+		if (row && row->name != NameTable::none)
+			highs.passRowName(row->row, row_names.get(row->name));
+}
+
+std::string OptimizationModel::colName(const ModelColumn& column) const
+{
+	if (column.name != NameTable::none)
+		return col_names.get(column.name);
+
+	const auto& names = highs.getLp().col_names_;
+	if (column.col >= 0 && column.col < synced_cols && column.col < names.size())
+		return names[column.col];
+
+	return "";
+}
+
+std::string OptimizationModel::rowName(const ModelRow& row) const
+{
+	if (row.name != NameTable::none)
+		return row_names.get(row.name);
+
+	const auto& names = highs.getLp().row_names_;
+	if (row.row >= 0 && row.row < synced_rows && row.row < names.size())
+		return names[row.row];
+
+	return "";
+}
+
+std::string ModelVar::getName() const
+{
+	return column->model->colName(*column);
+}
+
+std::string ModelConstraint::getName() const
+{
+	return row->model->rowName(*row);
+}
+
+ModelRelaxation::ModelRelaxation(OptimizationModel* model) : model(model), revision(0)
+{
+	model->update();
+	highs.passOptions(model->highs.getOptions());
+	pass();
+}
+
+/// <summary>
+/// Pass the model's LP without integrality, starting from its basis when one exists.
+/// </summary>
+void ModelRelaxation::pass()
+{
+	HighsLp lp = model->highs.getLp();
+	lp.integrality_.clear();
+	highs.passModel(std::move(lp));
+
+	if (model->highs.getBasis().valid)
+		highs.setBasis(model->highs.getBasis());
+
+	revision = model->revision;
+}
+
+/// <summary>
+/// Bring highs up to the model. Columns and rows appended since keep the basis, the new
+/// rows are added without their entries in the new columns, which come with the columns.
+/// </summary>
+void ModelRelaxation::sync()
+{
+	model->update();
+
+	const Highs& mip = model->highs;
+	HighsInt cols = highs.getNumCol();
+	HighsInt rows = highs.getNumRow();
+
+	if (revision != model->revision || cols > mip.getNumCol() || rows > mip.getNumRow()) {
+		pass();
+		return;
+	}
+
+	if (rows < mip.getNumRow()) {
+		HighsInt count, num_nz;
+		mip.getRows(rows, mip.getNumRow() - 1, count, nullptr, nullptr, num_nz, nullptr, nullptr, nullptr);
+
+		std::vector<double> lower(count), upper(count), value(num_nz);
+		std::vector<HighsInt> start(count + 1), index(num_nz);
+		mip.getRows(rows, mip.getNumRow() - 1, count, lower.data(), upper.data(), num_nz, start.data(), index.data(), value.data());
+		start[count] = num_nz;
+
+		HighsInt kept = 0, from = 0;
+		for (HighsInt r = 0; r < count; ++r) {
+			HighsInt end = start[r + 1];
+			start[r] = kept;
+
+			for (HighsInt k = from; k < end; ++k) {
+				if (index[k] < cols) {
+					index[kept] = index[k];
+					value[kept++] = value[k];
+				}
+			}
+
+			from = end;
+		}
+
+		highs.addRows(count, lower.data(), upper.data(), kept, start.data(), index.data(), value.data());
+	}
+
+	if (cols < mip.getNumCol()) {
+		HighsInt count, num_nz;
+		mip.getCols(cols, mip.getNumCol() - 1, count, nullptr, nullptr, nullptr, num_nz, nullptr, nullptr, nullptr);
+
+		std::vector<double> cost(count), lower(count), upper(count), value(num_nz);
+		std::vector<HighsInt> start(count), index(num_nz);
+		mip.getCols(cols, mip.getNumCol() - 1, count, cost.data(), lower.data(), upper.data(), num_nz, start.data(), index.data(), value.data());
+
+		highs.addCols(count, cost.data(), lower.data(), upper.data(), num_nz, start.data(), index.data(), value.data());
+	}
+
+	// the objective isn't counted in the revision, copying it is cheaper than tracking it
+	const HighsLp& lp = mip.getLp();
+	if (lp.num_col_ > 0)
+		highs.changeColsCost(0, lp.num_col_ - 1, lp.col_cost_.data());
+
+	highs.changeObjectiveSense(lp.sense_);
+	highs.changeObjectiveOffset(lp.offset_);
+}
+
+void ModelRelaxation::optimize()
+{
+	sync();
+	highs.run();
+}
+
+double ModelRelaxation::getValue(ModelVar v) const
+{
+	const auto& x = highs.getSolution().col_value;
+	if (v.index() < 0 || (size_t)v.index() >= x.size())
+		throw std::logic_error("variable has no value");
+
+	return x[v.index()];
+}
+
+/// <summary>
+/// Copy of this model with every column continuous, solved and changed on its own.
+/// </summary>
+OptimizationModel OptimizationModel::relax()
+{
+	update();
+	OptimizationModel lp(*this);
+
+	for (auto& col : lp.columns)
+		if (col)
+			col->integer = false;
+
+	HighsInt count = lp.highs.getNumCol();
+	if (count > 0 && lp.highs.getLp().isMip()) {
+		std::vector<HighsVarType> type(count, HighsVarType::kContinuous);
+		lp.highs.changeColsIntegrality(0, count - 1, type.data());
+	}
+
+	return lp;
+}
+
+/// <summary>
+/// Presolve this model and return the reduced model. highs keeps the reductions in this
+/// model, so the reduced model can be solved (repeatedly) and postsolved against it.
+/// </summary>
+OptimizationModel OptimizationModel::presolve()
+{
+	update();
+	highs.presolve();
+	return OptimizationModel(highs.getPresolvedModel(), this);
+}
+
+/// <summary>
+/// Map the solution and basis of a model returned by presolve() back onto the original
+/// model, whose ModelVar/ModelConstraint handles then see the postsolved values.
+/// </summary>
+void OptimizationModel::postsolve()
+{
+	if (original == nullptr)
+		throw std::logic_error("model was not created by presolve()");
+
+	if (original->highs.postsolve(highs.getSolution(), highs.getBasis()) == HighsStatus::kError)
+		throw std::runtime_error("postsolve failed");
+}
+
+/// <summary>
+/// Bounds and integrality of columns [from, columns.size()).
+/// </summary>
+void OptimizationModel::buildColumns(HighsInt from, std::vector<double>& lower, std::vector<double>& upper, std::vector<HighsVarType>& integrality) const
+{
+	HighsInt count = columns.size() - from;
+
+	lower.resize(count);
+	upper.resize(count);
+	integrality.resize(count);
+
+	for (HighsInt c = 0; c < count; ++c) {
+		const auto& col = column(from + c);
+		lower[c] = col->lb;
+		upper[c] = col->ub;
+		integrality[c] = col->integer ? HighsVarType::kInteger : HighsVarType::kContinuous;
+	}
+}
+
+/// <summary>
+/// Row bounds implied by the inequality of a constraint expression.
+/// </summary>
+void OptimizationModel::rowBounds(const ModelLinearExpression& expr, double& lower, double& upper)
+{
+	if (expr.type == ModelLinearExpression::Inequality::EQ) {	    // == rhs
+		lower = expr.rhs;
+		upper = expr.rhs;
+	}
+	else if (expr.type == ModelLinearExpression::Inequality::LE) { // <= rhs
+		lower = -kHighsInf;
+		upper = expr.rhs;
+	}
+	else if (expr.type == ModelLinearExpression::Inequality::Range) { // lhs <= . <= rhs
+		lower = expr.lhs;
+		upper = expr.rhs;
+	}
+	else {														    // >= rhs
+		lower = expr.rhs;
+		upper = kHighsInf;
+	}
+
+	// the row holds the terms only, x + 3 <= 5 is x <= 2
+	lower -= expr.constant;
+	upper -= expr.constant;
+}
+
+/// <summary>
+/// Row bounds of a row, streamed rows keep theirs in the streamed matrix.
+/// </summary>
+void OptimizationModel::rowBounds(const ModelRow& row, double& lower, double& upper) const
+{
+	if (row.streamed >= 0) {
+		lower = streamed.lower[row.streamed];
+		upper = streamed.upper[row.streamed];
+	}
+	else {
+		rowBounds(row.expr, lower, upper);
+	}
+}
+
+size_t OptimizationModel::rowLength(const ModelRow& row) const
+{
+	if (row.streamed >= 0)
+		return streamed.start[row.streamed + 1] - streamed.start[row.streamed];
+
+	return row.expr.terms.size();
+}
+
+/// <summary>
+/// Row bounds and column-wise sparse matrix of all rows, by a counting sort of the row
+/// terms on their column. Saves highs transposing a row-wise matrix into a second copy.
+/// </summary>
+void OptimizationModel::buildColwise(std::vector<double>& lower, std::vector<double>& upper, std::vector<HighsInt>& start, std::vector<HighsInt>& index, std::vector<double>& value) const
+{
+	HighsInt num_row = rows.size();
+
+	lower.resize(num_row);
+	upper.resize(num_row);
+	start.assign(columns.size() + 1, 0);
+
+	// bounds and column counts
+	for (HighsInt r = 0; r < num_row; ++r) {
+		const ModelRow& row = *rows[r];
+		rowBounds(row, lower[r], upper[r]);
+
+		if (row.streamed >= 0) {
+			for (HighsInt k = streamed.start[row.streamed]; k < streamed.start[row.streamed + 1]; ++k)
+				++start[streamed.index[k] + 1];
+		}
+
+		for (const auto& term : row.expr.terms)
+			++start[colIndex(term.var) + 1];
+	}
+
+	for (HighsInt c = 0; c < columns.size(); ++c)
+		start[c + 1] += start[c];
+
+	index.resize(start.back());
+	value.resize(start.back());
+
+	// rows are visited in order, so every column comes out sorted by row
+	std::vector<HighsInt> next(start.begin(), start.end() - 1);
+
+	for (HighsInt r = 0; r < num_row; ++r) {
+		const ModelRow& row = *rows[r];
+
+		if (row.streamed >= 0) {
+			for (HighsInt k = streamed.start[row.streamed]; k < streamed.start[row.streamed + 1]; ++k) {
+				HighsInt p = next[streamed.index[k]]++;
+				index[p] = r;
+				value[p] = streamed.value[k];
+			}
+		}
+
+		for (const auto& term : row.expr.terms) {
+			HighsInt p = next[colIndex(term.var)]++;
+			index[p] = r;
+			value[p] = term.coeff;
+		}
+	}
+}
+
+/// <summary>
+/// Bounds and row-wise sparse matrix of rows [from, rows.size()). Large ranges are
+/// assembled in parallel: per-chunk row lengths and bounds, a prefix sum over the chunk
+/// totals, then every chunk scatters its terms into the preallocated arrays.
+/// </summary>
+void OptimizationModel::buildRows(HighsInt from, std::vector<double>& lower, std::vector<double>& upper, std::vector<HighsInt>& start, std::vector<HighsInt>& index, std::vector<double>& value) const
+{
+	HighsInt count = rows.size() - from;
+	int chunks = parallelChunks(count, assembly_threads);
+
+	lower.resize(count);
+	upper.resize(count);
+	start.resize(count + 1);
+	start[0] = 0;
+
+	// start[r + 1] holds the prefix within the chunk for now
+	std::vector<HighsInt> chunk_start(chunks + 1, 0);
+
+	parallelFor(count, chunks, [&](HighsInt begin, HighsInt end, int chunk) {
+		HighsInt nnz = 0;
+
+		for (HighsInt r = begin; r < end; ++r) {
+			const ModelRow& row = *rows[from + r];
+
+			rowBounds(row, lower[r], upper[r]);
+			nnz += rowLength(row);
+			start[r + 1] = nnz;
+		}
+
+		chunk_start[chunk + 1] = nnz;
+	});
+
+	for (int chunk = 0; chunk < chunks; ++chunk)
+		chunk_start[chunk + 1] += chunk_start[chunk];
+
+	index.resize(chunk_start[chunks]);
+	value.resize(chunk_start[chunks]);
+
+	parallelFor(count, chunks, [&](HighsInt begin, HighsInt end, int chunk) {
+		HighsInt offset = chunk_start[chunk];
+
+		for (HighsInt r = begin; r < end; ++r) {
+			const ModelRow& row = *rows[from + r];
+
+			if (row.streamed >= 0) {
+				for (HighsInt k = streamed.start[row.streamed]; k < streamed.start[row.streamed + 1]; ++k) {
+					index[offset] = streamed.index[k];
+					value[offset] = streamed.value[k];
+					++offset;
+				}
+			}
+
+			for (const auto& term : row.expr.terms) {
+				index[offset] = colIndex(term.var);
+				value[offset] = term.coeff;
+				++offset;
+			}
+			start[r + 1] = offset;
+		}
+	});
+}
+
+/// <summary>
+/// Dense cost vector over all columns.
+/// </summary>
+void OptimizationModel::buildCost(std::vector<double>& cost) const
+{
+	cost.assign(columns.size(), 0.0);
+	for (const auto& term : objective.terms)
+		cost[colIndex(term.var)] += term.coeff;
+}
+
+// drop the entries flagged in mask, v may be shorter than mask
+template <typename T>
+static void dropMasked(std::vector<T>& v, const std::vector<HighsInt>& mask)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < v.size(); ++i)
+		if (i >= mask.size() || !mask[i])
+			v[count++] = v[i];
+	v.resize(count);
+}
+
+/// <summary>
+/// Apply queued removals in one batch: a single deleteCols/deleteRows mask for the
+/// synced part and one compaction pass renumbering the remaining columns and rows.
+/// Terms of removed variables are dropped from the rows and the objective.
+/// </summary>
+void OptimizationModel::applyRemovals()
+{
+	// highs still holds the basis and solution of the last solve, deleting rows or columns drops them
+	if (warm_start && synced && (removed_rows > 0 || removed_cols > 0))
+		captureWarmStart();
+
+	if (removed_rows > 0) {
+		std::vector<HighsInt> mask(synced_rows, 0);
+		HighsInt count = 0, kept_synced = 0;
+
+		for (HighsInt r = 0; r < rows.size(); ++r) {
+			if (!rows[r]) {
+				if (r < synced_rows) ++kept_synced;
+				rows[count++] = std::move(rows[r]);
+				continue;
+			}
+
+			if (rows[r]->row < 0) {
+				if (r < synced_rows) mask[r] = 1;
+
+				// handles may outlive the row, its terms go back to the arena for the rows that follow
+				rows[r]->release();
+				continue;
+			}
+
+			if (r < synced_rows) ++kept_synced;
+			rows[r]->row = count;
+			rows[count++] = std::move(rows[r]);
+		}
+
+		rows.resize(count);
+		dropMasked(warm.row_status, mask);
+		dropMasked(warm.row_dual, mask);
+		warm.changed = true;
+
+		if (synced && synced_rows > 0) {
+			highs.deleteRows(mask.data());
+			row_matrix_valid = false;
+			++revision;
+		}
+
+		synced_rows = kept_synced;
+		removed_rows = 0;
+	}
+
+	if (removed_cols > 0) {
+		std::vector<HighsInt> mask(synced_cols, 0);
+		HighsInt count = 0, kept_synced = 0;
+
+		// new index of every old column, for the streamed rows
+		std::vector<HighsInt> remap(streamed.index.empty() ? 0 : columns.size(), -1);
+
+		for (HighsInt c = 0; c < columns.size(); ++c) {
+			if (!columns[c]) {
+				if (c < synced_cols) ++kept_synced;
+				if (!remap.empty()) remap[c] = count;
+				columns[count++] = std::move(columns[c]);
+				continue;
+			}
+
+			if (columns[c]->col < 0) {
+				if (c < synced_cols) mask[c] = 1;
+				continue;
+			}
+
+			if (c < synced_cols) ++kept_synced;
+			if (!remap.empty()) remap[c] = count;
+			columns[c]->col = count;
+			col_slots[columns[c]->ref.id].col = count;
+			columns[count++] = std::move(columns[c]);
+		}
+
+		columns.resize(count);
+		dropMasked(warm.col_status, mask);
+		dropMasked(warm.col_value, mask);
+		warm.changed = true;
+
+		if (synced && synced_cols > 0) {
+			highs.deleteCols(mask.data());
+			row_matrix_valid = false;
+			++revision;
+		}
+
+		synced_cols = kept_synced;
+		removed_cols = 0;
+
+		for (auto& row : rows) {
+			if (row) {
+				row->expr.dropRemovedVars();
+				row->dropIndex();
+			}
+		}
+
+		objective.dropRemovedVars();
+
+		if (!remap.empty())
+			remapStreamed(remap);
+	}
+}
+
+/// <summary>
+/// Renumber the columns of the streamed rows after a compaction, dropping removed ones.
+/// </summary>
+void OptimizationModel::remapStreamed(const std::vector<HighsInt>& remap)
+{
+	auto& start = streamed.start;
+	auto& index = streamed.index;
+	auto& value = streamed.value;
+	size_t nnz = 0, k = 0;
+
+	// the open row of a builder goes last, past start.back()
+	for (size_t s = 0; s <= streamed.lower.size(); ++s) {
+		size_t end = s < streamed.lower.size() ? start[s + 1] : index.size();
+
+		for (; k < end; ++k) {
+			if (remap[index[k]] >= 0) {
+				index[nnz] = remap[index[k]];
+				value[nnz++] = value[k];
+			}
+		}
+
+		if (s < streamed.lower.size())
+			start[s + 1] = nnz;
+	}
+
+	index.resize(nnz);
+	value.resize(nnz);
+}
+
+/// <summary>
+/// True when the pending rows are exactly the streamed rows, in order, so the streamed
+/// matrix can be passed to highs as it is.
+/// </summary>
+bool OptimizationModel::streamedOnly() const
+{
+	HighsInt first = synced ? synced_rows : 0;
+	HighsInt count = streamed.lower.size();
+
+	if (count == 0 || rows.size() - first != count)
+		return false;
+
+	for (HighsInt r = 0; r < count; ++r)
+		if (rows[first + r]->streamed != r)
+			return false;
+
+	return true;
+}
+
+/// <summary>
+/// Drop the streamed rows once highs has them, they become adopted rows. Keeps the terms
+/// of a row an open builder hasn't committed yet.
+/// </summary>
+void OptimizationModel::releaseStreamed()
+{
+	for (HighsInt r = synced ? synced_rows : 0; r < rows.size(); ++r) {
+		rows[r]->streamed = -1;
+		rows[r]->dropIndex();
+	}
+
+	StreamedRows rest;
+	HighsInt committed = streamed.start.back();
+	rest.index.assign(streamed.index.begin() + std::min<size_t>(committed, streamed.index.size()), streamed.index.end());
+	rest.value.assign(streamed.value.begin() + std::min<size_t>(committed, streamed.value.size()), streamed.value.end());
+	streamed = std::move(rest);
+}
+
+/// <summary>
+/// Assemble the full highs model from the wrapper, without passing it to highs.
+/// Expects canonical rows, see update(). Only for models not yet passed to highs: rows
+/// already there may exist only in highs, so they can't be assembled from the wrapper.
+/// </summary>
+void OptimizationModel::assemble(HighsModel& model) const
+{
+	if (synced)
+		throw std::logic_error("model was already passed to highs, use highs.getLp()");
+
+	assembleColumns(model);
+
+	// rows, large matrices are built in the column-wise orientation highs solves with
+	bool colwise = assembly_format == AssemblyFormat::Colwise;
+
+	if (assembly_format == AssemblyFormat::Auto) {
+		size_t nnz = 0;
+		for (const auto& row : rows)
+			nnz += rowLength(*row);
+
+		colwise = nnz >= kColwiseNonzeros;
+	}
+
+	auto& a = model.lp_.a_matrix_;
+	a.num_col_ = model.lp_.num_col_;
+	a.num_row_ = model.lp_.num_row_;
+
+	if (colwise) {
+		a.format_ = MatrixFormat::kColwise;
+		buildColwise(model.lp_.row_lower_, model.lp_.row_upper_, a.start_, a.index_, a.value_);
+	}
+	else {
+		a.format_ = MatrixFormat::kRowwise;
+		buildRows(0, model.lp_.row_lower_, model.lp_.row_upper_, a.start_, a.index_, a.value_);
+	}
+}
+
+/// <summary>
+/// Everything of the highs model but the row bounds and the matrix.
+/// </summary>
+void OptimizationModel::assembleColumns(HighsModel& model) const
+{
+	model.lp_.num_col_ = columns.size();
+	model.lp_.num_row_ = rows.size();
+	model.lp_.offset_ = objective.constant;
+	model.lp_.sense_ = sense;
+
+	// columns
+	buildCost(model.lp_.col_cost_);
+	buildColumns(0, model.lp_.col_lower_, model.lp_.col_upper_, model.lp_.integrality_);
+
+	// remove integrality vector if model is completely continuous
+	bool integer = false;
+	for (const auto& col : columns)
+		integer |= col && col->integer;
+
+	if (integer == false)
+		model.lp_.integrality_.clear();
+}
+
+/// <summary>
+/// Convert wrapper class to highs model. 
+/// This is done lazily: the first call passes the full model, later calls only push
+/// the columns, rows and objective changes made since, so highs keeps its basis.
+/// </summary>
+void OptimizationModel::update()
+{
+	applyRemovals();
+
+	// canonical rows and objective, so highs never sees duplicate entries
+	HighsInt first = synced ? synced_rows : 0;
+	HighsInt pending = rows.size() - first;
+
+	int chunks = parallelChunks(pending, assembly_threads);
+	if (compress_scratch.size() < chunks)
+		compress_scratch.resize(chunks);
+
+	parallelFor(pending, chunks, [&](HighsInt begin, HighsInt end, int chunk) {
+		for (HighsInt r = first + begin; r < first + end; ++r)
+			rows[r]->expr.compress(kHighsTiny, compress_scratch[chunk]);
+	});
+
+	// compress() moved the terms; the indexes free into the arena, which is for one thread only
+	for (HighsInt r = first; r < rows.size(); ++r)
+		if (rows[r]->indexed)
+			rows[r]->dropIndex();
+
+	if (objective_changed)
+		objective.compress();
+
+	if (!synced) {
+		HighsModel model;
+
+		// a model built with rowBuilder() hands its matrix over instead of copying it
+		if (streamedOnly()) {
+			assembleColumns(model);
+
+			HighsInt nnz = streamed.start.back();
+			std::vector<HighsInt> index(streamed.index.begin() + nnz, streamed.index.end());
+			std::vector<double> value(streamed.value.begin() + nnz, streamed.value.end());
+			streamed.index.resize(nnz);
+			streamed.value.resize(nnz);
+
+			auto& a = model.lp_.a_matrix_;
+			a.format_ = MatrixFormat::kRowwise;
+			a.num_col_ = model.lp_.num_col_;
+			a.num_row_ = model.lp_.num_row_;
+			model.lp_.row_lower_ = std::move(streamed.lower);
+			model.lp_.row_upper_ = std::move(streamed.upper);
+			a.start_ = std::move(streamed.start);
+			a.index_ = std::move(streamed.index);
+			a.value_ = std::move(streamed.value);
+
+			// only the open row of a builder is left
+			streamed = StreamedRows();
+			streamed.index = std::move(index);
+			streamed.value = std::move(value);
+		}
+		else {
+			assemble(model);
+		}
+
+		highs.passModel(std::move(model));
+		releaseStreamed();
+		row_matrix_valid = false;
+
+		synced = true;
+		synced_cols = columns.size();
+		synced_rows = rows.size();
+		objective_changed = false;
+		return;
+	}
+
+	// new columns are added without cost, the objective is pushed below if it changed
+	if (synced_cols < columns.size()) {
+		std::vector<double> lower, upper;
+		std::vector<HighsVarType> integrality;
+		buildColumns(synced_cols, lower, upper, integrality);
+
+		HighsInt count = lower.size();
+		std::vector<double> cost(count, 0.0);
+		highs.addCols(count, cost.data(), lower.data(), upper.data(), 0, nullptr, nullptr, nullptr);
+
+		std::vector<HighsInt> set;
+		for (HighsInt c = 0; c < count; ++c)
+			if (integrality[c] != HighsVarType::kContinuous)
+				set.push_back(synced_cols + c);
+
+		if (!set.empty()) {
+			std::vector<HighsVarType> type(set.size(), HighsVarType::kInteger);
+			highs.changeColsIntegrality(set.size(), set.data(), type.data());
+		}
+
+		synced_cols = columns.size();
+	}
+
+	if (synced_rows < rows.size()) {
+		if (streamedOnly()) {
+			highs.addRows(streamed.lower.size(), streamed.lower.data(), streamed.upper.data(),
+				streamed.start.back(), streamed.start.data(), streamed.index.data(), streamed.value.data());
+		}
+		else {
+			std::vector<double> lower, upper, value;
+			std::vector<HighsInt> start, index;
+			buildRows(synced_rows, lower, upper, start, index, value);
+
+			highs.addRows(lower.size(), lower.data(), upper.data(), value.size(), start.data(), index.data(), value.data());
+		}
+
+		releaseStreamed();
+		synced_rows = rows.size();
+		row_matrix_valid = false;
+	}
+
+	if (objective_changed) {
+		std::vector<double> cost;
+		buildCost(cost);
+
+		if (!cost.empty())
+			highs.changeColsCost(0, cost.size() - 1, cost.data());
+
+		highs.changeObjectiveSense(sense);
+		highs.changeObjectiveOffset(objective.constant);
+		objective_changed = false;
+	}
+}
+
+void OptimizationModel::optimize()
+{
+	update();
+
+	// highs keeps its basis through added columns and rows, not always through removals
+	bool captured = warm.basis || warm.solution;
+	if (warm_start && captured && (warm.changed || (warm.basis && !highs.getBasis().valid)))
+		applyWarmStart();
+
+	// a MIP solve ends without a basis, the LP basis highs holds is kept for later solves
+	if (warm_start && highs.getBasis().valid) {
+		bool mip = false;
+		for (auto type : highs.getLp().integrality_)
+			mip |= type != HighsVarType::kContinuous;
+
+		if (mip)
+			captureWarmStart();
+	}
+
+	highs.run();
+}
+
+/// <summary>
+/// Keep the basis and solution highs holds for applyWarmStart(), taken only when highs is
+/// about to lose them: before removals are applied and before a MIP solve.
+/// </summary>
+void OptimizationModel::captureWarmStart()
+{
+	const HighsBasis& basis = highs.getBasis();
+	const HighsSolution& solution = highs.getSolution();
+
+	// without a basis in highs, the one of the last LP solve is kept for the next
+	warm.changed = false;
+	warm.solution = solution.value_valid;
+	warm.col_value.clear();
+	warm.row_dual.clear();
+
+	if (basis.valid) {
+		warm.basis = true;
+		warm.col_status = basis.col_status;
+		warm.row_status = basis.row_status;
+	}
+
+	if (warm.solution)
+		warm.col_value = solution.col_value;
+
+	if (solution.dual_valid)
+		warm.row_dual = solution.row_dual;
+}
+
+// a nonbasic status the bounds allow, the given one if they do
+static HighsBasisStatus nonbasicStatus(HighsBasisStatus status, double lower, double upper)
 {
-	// populate from wrapper class
-	for (int col = 0; col < m.columns.size(); ++col)
-		columns.push_back(std::shared_ptr<ModelColumn>(new ModelColumn(this, col, m.columns[col]->name)));
+	if (status == HighsBasisStatus::kLower && lower > -kHighsInf)
+		return status;
+	if (status == HighsBasisStatus::kUpper && upper < kHighsInf)
+		return status;
+
+	if (lower > -kHighsInf && (upper == kHighsInf || std::fabs(lower) <= std::fabs(upper)))
+		return HighsBasisStatus::kLower;
+	if (upper < kHighsInf)
+		return HighsBasisStatus::kUpper;
+
+	return HighsBasisStatus::kZero;
+}
+
+/// <summary>
+/// Hand the captured basis and solution to highs, extended to the columns and rows added
+/// since: new rows are basic, new columns nonbasic at the bound nearest zero. When removals
+/// left more or fewer basic variables than rows, highs gets the basis as alien and repairs it.
+/// </summary>
+void OptimizationModel::applyWarmStart()
+{
+	const HighsLp& lp = highs.getLp();
+	HighsInt num_col = lp.num_col_, num_row = lp.num_row_;
+
+	std::vector<HighsBasisStatus> col_status(num_col);
+	for (HighsInt c = 0; c < num_col; ++c) {
+		HighsBasisStatus status = c < (HighsInt)warm.col_status.size() ? warm.col_status[c] : HighsBasisStatus::kNonbasic;
+		col_status[c] = status == HighsBasisStatus::kBasic ? status : nonbasicStatus(status, lp.col_lower_[c], lp.col_upper_[c]);
+	}
+
+	if (warm.solution) {
+		HighsSolution solution;
+		solution.col_value = warm.col_value;
+		solution.col_value.resize(num_col);
+
+		for (HighsInt c = warm.col_value.size(); c < num_col; ++c) {
+			if (col_status[c] == HighsBasisStatus::kLower)
+				solution.col_value[c] = lp.col_lower_[c];
+			else if (col_status[c] == HighsBasisStatus::kUpper)
+				solution.col_value[c] = lp.col_upper_[c];
+		}
+
+		solution.value_valid = true;
+
+		if (!warm.row_dual.empty()) {
+			solution.row_dual = warm.row_dual;
+			solution.row_dual.resize(num_row, 0.0);
+			solution.dual_valid = true;
+		}
+
+		highs.setSolution(solution);
+	}
+
+	if (warm.basis) {
+		HighsBasis basis;
+		basis.col_status = std::move(col_status);
+		basis.row_status.resize(num_row, HighsBasisStatus::kBasic);
+
+		HighsInt basic = 0;
+		for (HighsInt r = 0; r < num_row; ++r) {
+			if (r < (HighsInt)warm.row_status.size() && warm.row_status[r] != HighsBasisStatus::kBasic)
+				basis.row_status[r] = nonbasicStatus(warm.row_status[r], lp.row_lower_[r], lp.row_upper_[r]);
+			basic += basis.row_status[r] == HighsBasisStatus::kBasic;
+		}
+
+		for (auto status : basis.col_status)
+			basic += status == HighsBasisStatus::kBasic;
 
-	for (int row = 0; row < m.rows.size(); ++row)
-		rows.push_back(std::shared_ptr<ModelRow>(new ModelRow(this, row, m.rows[row]->name)));
+		basis.valid = true;
+		basis.alien = basic != num_row;
+		highs.setBasis(basis);
+	}
+
+	warm.changed = false;
+}
 
-	objective = m.objective;
+// position of index i in a change set without repeats, appended the first time i is seen
+static size_t changeSlot(std::unordered_map<HighsInt, size_t>& seen, std::vector<HighsInt>& set, HighsInt i)
+{
+	auto it = seen.emplace(i, set.size()).first;
+	if (it->second == set.size())
+		set.push_back(i);
+	return it->second;
 }
 
-OptimizationModel::OptimizationModel(const HighsModel& m)
+/// <summary>
+/// Apply a scenario to h as a delta, solve from the basis h holds and restore the values
+/// the scenario replaced, so h is back at the model for the next scenario.
+/// </summary>
+void OptimizationModel::solveScenario(Highs& h, const ModelScenario& scenario, ScenarioResult& result, bool primal) const
 {
-	// populate from highs model
-	for (int col = 0; col < m.lp_.num_col_; ++col) {
-		std::string name = m.lp_.col_names_.size() > col ? m.lp_.col_names_[col] : "";
-		columns.push_back(std::shared_ptr<ModelColumn>(new ModelColumn(this, col, name)));
+	const HighsLp& lp = h.getLp();
+
+	// highs takes each index once per call, a row or column set twice keeps its last value
+	// and is restored from the one old value taken before any change
+	std::unordered_map<HighsInt, size_t> seen;
+	std::vector<HighsInt> rows;
+	std::vector<double> row_lower, row_upper, old_row_lower, old_row_upper;
+
+	for (const auto& entry : scenario.row_bounds) {
+		size_t k = changeSlot(seen, rows, entry.row.index());
+		row_lower.resize(rows.size());
+		row_upper.resize(rows.size());
+		old_row_lower.resize(rows.size());
+		old_row_upper.resize(rows.size());
+
+		row_lower[k] = entry.lower;
+		row_upper[k] = entry.upper;
+		old_row_lower[k] = lp.row_lower_[rows[k]];
+		old_row_upper[k] = lp.row_upper_[rows[k]];
 	}
 
-	for (int row = 0; row < m.lp_.num_row_; ++row) {
-		std::string name = m.lp_.row_names_.size() > row ? m.lp_.row_names_[row] : "";
-		rows.push_back(std::shared_ptr<ModelRow>(new ModelRow(this, row, name)));
+	seen.clear();
+	std::vector<HighsInt> cols;
+	std::vector<double> col_lower, col_upper, old_col_lower, old_col_upper;
+
+	for (const auto& entry : scenario.col_bounds) {
+		size_t k = changeSlot(seen, cols, entry.col.index());
+		col_lower.resize(cols.size());
+		col_upper.resize(cols.size());
+		old_col_lower.resize(cols.size());
+		old_col_upper.resize(cols.size());
+
+		col_lower[k] = entry.lower;
+		col_upper[k] = entry.upper;
+		old_col_lower[k] = lp.col_lower_[cols[k]];
+		old_col_upper[k] = lp.col_upper_[cols[k]];
 	}
 
-	objective.clear();
-	const auto& obj = m.lp_.col_cost_;
-	objective = m.lp_.offset_;
+	seen.clear();
+	std::vector<HighsInt> cost_cols;
+	std::vector<double> cost, old_cost;
 
-	for (int i = 0; i < m.lp_.num_col_; i++) {
-		if (obj[i] != 0.0) {
-			objective += obj[i] * columns[i];
-		}
+	for (const auto& entry : scenario.costs) {
+		size_t k = changeSlot(seen, cost_cols, entry.col.index());
+		cost.resize(cost_cols.size());
+		old_cost.resize(cost_cols.size());
+
+		cost[k] = entry.cost;
+		old_cost[k] = lp.col_cost_[cost_cols[k]];
 	}
+
+	HighsInt num_rows = rows.size(), num_cols = cols.size(), num_costs = cost_cols.size();
+
+	if (num_rows > 0)
+		h.changeRowsBounds(num_rows, rows.data(), row_lower.data(), row_upper.data());
+	if (num_cols > 0)
+		h.changeColsBounds(num_cols, cols.data(), col_lower.data(), col_upper.data());
+	if (num_costs > 0)
+		h.changeColsCost(num_costs, cost_cols.data(), cost.data());
+
+	h.run();
+
+	result.status = h.getModelStatus();
+	result.objective = h.getInfo().objective_function_value;
+	if (primal)
+		result.col_value = h.getSolution().col_value;
+
+	if (num_costs > 0)
+		h.changeColsCost(num_costs, cost_cols.data(), old_cost.data());
+	if (num_cols > 0)
+		h.changeColsBounds(num_cols, cols.data(), old_col_lower.data(), old_col_upper.data());
+	if (num_rows > 0)
+		h.changeRowsBounds(num_rows, rows.data(), old_row_lower.data(), old_row_upper.data());
 }
 
-void OptimizationModel::read(const string& filename)
+/// <summary>
+/// Solve a batch of scenarios against this model without rebuilding it: each scenario is
+/// applied to highs as a delta and warm started from the basis of the previous solve.
+/// With threads != 1 the scenarios are split into contiguous blocks, the first solved by
+/// this model's highs and every other one by its own copy of it.
+/// </summary>
+std::vector<ScenarioResult> OptimizationModel::solveBatch(const std::vector<ModelScenario>& scenarios, bool primal, int threads)
 {
-	model.reset();
-	highs.readModel(filename);
+	update();
 
-	// populate from highs
-	for (int col = 0; col < highs.getNumCol(); ++col) {
-		std::string name;
-		highs.getColName(col, name);
-		columns.push_back(std::shared_ptr<ModelColumn>(new ModelColumn(this, col, name)));
-	}
+	// handles are checked up front, the solves below run on worker threads
+	auto valid = [this](const std::shared_ptr<ModelColumn>& col) { return col && col->model == this && col->col >= 0; };
 
-	for (int row = 0; row < highs.getNumRow(); ++row) {
-		std::string name;
-		highs.getRowName(row, name);
-		rows.push_back(std::shared_ptr<ModelRow>(new ModelRow(this, row, name)));
-	}
+	for (const auto& scenario : scenarios) {
+		for (const auto& entry : scenario.row_bounds)
+			if (!entry.row.row || entry.row.row->model != this || entry.row.row->row < 0)
+				throw std::invalid_argument("scenarios");
 
-	objective.clear();
-	const auto& obj = highs.getLp().col_cost_;
-	objective = highs.getLp().offset_;
+		for (const auto& entry : scenario.col_bounds)
+			if (!valid(entry.col.column))
+				throw std::invalid_argument("scenarios");
 
-	for (int i = 0; i < highs.getNumCol(); i++) {
-		if (obj[i] != 0.0) {
-			objective += obj[i] * columns[i];
-		}
+		for (const auto& entry : scenario.costs)
+			if (!valid(entry.col.column))
+				throw std::invalid_argument("scenarios");
 	}
+
+	std::vector<ScenarioResult> results(scenarios.size());
+	int chunks = parallelChunks(scenarios.size(), threads, 1);
+
+	// copies are made before any solve touches highs, each in its own thread
+	std::vector<std::unique_ptr<Highs>> clones(chunks);
+
+	parallelFor(chunks, chunks, [&](long long, long long, int chunk) {
+		if (chunk == 0)
+			return;
+
+		clones[chunk].reset(new Highs());
+		clones[chunk]->passOptions(highs.getOptions());
+		clones[chunk]->passModel(highs.getLp());
+		if (highs.getBasis().valid)
+			clones[chunk]->setBasis(highs.getBasis());
+	});
+
+	parallelFor(scenarios.size(), chunks, [&](long long begin, long long end, int chunk) {
+		Highs& h = chunk == 0 ? highs : *clones[chunk];
+
+		for (long long s = begin; s < end; ++s)
+			solveScenario(h, scenarios[s], results[s], primal);
+	});
+
+	return results;
 }
 
-void OptimizationModel::write(const string& filename)
+void OptimizationModel::minimize(ModelLinearExpression obj)
 {
-	update();
-	highs.writeModel(filename);
+	setObjective(std::move(obj), ObjSense::kMinimize);
+	optimize();
 }
 
-OptimizationModel OptimizationModel::relax()
+void OptimizationModel::maximize(ModelLinearExpression obj)
 {
-	throw std::logic_error("not implemented");
+	setObjective(std::move(obj), ObjSense::kMaximize);
+	optimize();
 }
 
-OptimizationModel OptimizationModel::presolve()
+double OptimizationModel::getValue(ModelVar v) const
 {
-	update();
-	highs.presolve();
-	return OptimizationModel(highs.getPresolvedModel());
+	if (!v.column || v.column->model != this || v.column->col < 0)
+		throw std::invalid_argument("v");
+
+	ModelValueSpan x = colValues();
+	if ((size_t)v.column->col >= x.size())
+		throw std::logic_error("variable has no value");
+
+	return x[v.column->col];
 }
 
 /// <summary>
-/// Convert wrapper class to highs model. 
-/// This is done lazily, so that the sparse matrix is only updated when needed.
+/// Value of the expression at the last solution. Terms of removed variables count as zero.
 /// </summary>
-void OptimizationModel::update()
+double OptimizationModel::getValue(const ModelLinearExpression& expr) const
 {
-	if (model == nullptr) {
-		model.reset(new HighsModel());
-		
-		model->lp_.num_col_ = columns.size();
-		model->lp_.num_row_ = rows.size();
-		model->lp_.offset_ = objective.constant;
-		model->lp_.sense_ = sense;
-
-		// columns
-		model->lp_.col_cost_.resize(columns.size());
-		for (int c = 0; c < objective.coeffs.size(); ++c)
-			model->lp_.col_cost_[objective.vars[c].index()] = objective.coeffs[c];
-
-		model->lp_.col_lower_.resize(columns.size());
-		model->lp_.col_upper_.resize(columns.size());
-		model->lp_.integrality_.resize(columns.size());
-
-		bool integer = false;
-
-		for (int c = 0; c < columns.size(); ++c) {
-			model->lp_.col_lower_[c] = columns[c]->lb;
-			model->lp_.col_upper_[c] = columns[c]->ub;
-			model->lp_.integrality_[c] = columns[c]->integer ? HighsVarType::kInteger : HighsVarType::kContinuous;
-			integer |= columns[c]->integer;
-		}
+	if (expr.model != nullptr && expr.model != this)
+		throw std::invalid_argument("expr");
 
-		// remove integrality vector if model is completely continuous
-		if (integer == false)
-			model->lp_.integrality_.clear();
+	ModelValueSpan x = colValues();
+	double value = expr.constant;
 
-		// rows
-		model->lp_.row_lower_.resize(rows.size());
-		model->lp_.row_upper_.resize(rows.size());
+	for (const ModelTerm& term : expr.terms) {
+		HighsInt col = colIndex(term.var);
+		if (col < 0) continue;
+		if ((size_t)col >= x.size())
+			throw std::logic_error("variable has no value");
+		value += term.coeff * x[col];
+	}
+	return value;
+}
 
-		for (int r = 0; r < rows.size(); ++r) {
-			auto& row = rows[r];
+double OptimizationModel::getDual(ModelConstraint c) const
+{
+	if (!c.row || c.row->model != this || c.row->row < 0)
+		throw std::invalid_argument("c");
 
-			// TODO: check constant vs RHS logic
-			if (row->expr.type == ModelLinearExpression::Inequality::EQ) {	    // == rhs
-				model->lp_.row_lower_[r] = row->expr.rhs;
-				model->lp_.row_upper_[r] = row->expr.rhs;
-			}
-			else if (row->expr.type == ModelLinearExpression::Inequality::LE) { // <= rhs
-				model->lp_.row_lower_[r] = -kHighsInf;
-				model->lp_.row_upper_[r] = row->expr.rhs;
-			}
-			else {															    // >= rhs
-				model->lp_.row_lower_[r] = row->expr.rhs;
-				model->lp_.row_upper_[r] = kHighsInf;
-			}
-		}
+	ModelValueSpan y = rowDuals();
+	if ((size_t)c.row->row >= y.size())
+		throw std::logic_error("constraint has no dual");
 
-		// The orientation of the matrix is row-wise
-		model->lp_.a_matrix_.format_ = MatrixFormat::kRowwise;
+	return y[c.row->row];
+}
 
-		model->lp_.a_matrix_.start_.resize(rows.size() + 1);
-		int nnz = 0;
+ModelValueSpan OptimizationModel::colValues() const
+{
+	if (!highs.getSolution().value_valid)
+		throw std::logic_error("no solution");
+	return highs.getSolution().col_value;
+}
 
-		for (int r = 0; r < rows.size(); ++r) {
-			nnz += rows[r]->expr.coeffs.size();
-			model->lp_.a_matrix_.start_[r+1] = nnz;
-		}
+ModelValueSpan OptimizationModel::rowValues() const
+{
+	if (!highs.getSolution().value_valid)
+		throw std::logic_error("no solution");
+	return highs.getSolution().row_value;
+}
 
-		model->lp_.a_matrix_.index_.resize(nnz);
-		model->lp_.a_matrix_.value_.resize(nnz);
-		int offset = 0;
+ModelValueSpan OptimizationModel::rowDuals() const
+{
+	if (!highs.getSolution().dual_valid)
+		throw std::logic_error("no dual solution");
+	return highs.getSolution().row_dual;
+}
 
-		for (int r = 0; r < rows.size(); ++r) {
-			for (int i = 0; i < rows[r]->expr.coeffs.size(); ++i) {
-				model->lp_.a_matrix_.index_[offset] = rows[r]->expr.vars[i].index();
-				model->lp_.a_matrix_.value_[offset] = rows[r]->expr.coeffs[i];
-				++offset;
-			}
-		}
+double ModelVar::getValue() const
+{
+	if (!column)
+		throw std::invalid_argument("var");
+	return column->model->getValue(*this);
+}
 
-		highs.passModel(*model);
-	}
+double ModelLinearExpression::getValue() const
+{
+	return model ? model->getValue(*this) : constant;
 }
 
-void OptimizationModel::optimize()
+/// <summary>
+/// The matrix in highs row-wise, the one highs holds if it is row-wise already. A column-wise
+/// matrix is transposed once and kept until the model changes it.
+/// </summary>
+/// <summary>
+/// Whether update() has anything to pass to highs.
+/// </summary>
+bool OptimizationModel::pendingChanges() const
 {
-	update();
-	highs.run();
+	return !synced || synced_cols < columns.size() || synced_rows < rows.size()
+		|| removed_cols > 0 || removed_rows > 0 || objective_changed;
 }
 
-void OptimizationModel::minimize(ModelLinearExpression obj)
+const HighsSparseMatrix& OptimizationModel::rowwiseMatrix()
 {
-	setObjective(obj, ObjSense::kMinimize);
-	optimize();
+	// evaluate() is called in loops, an unchanged model skips update()
+	if (pendingChanges())
+		update();
+
+	const HighsSparseMatrix& a = highs.getLp().a_matrix_;
+	if (a.isRowwise())
+		return a;
+
+	if (!row_matrix_valid || row_matrix.num_row_ != a.num_row_ || row_matrix.numNz() != a.numNz()) {
+		row_matrix = a;
+		row_matrix.ensureRowwise();
+		row_matrix_valid = true;
+	}
+	return row_matrix;
 }
 
-void OptimizationModel::maximize(ModelLinearExpression obj)
+ModelEvaluation OptimizationModel::evaluate(const double* x, int threads)
 {
-	setObjective(obj, ObjSense::kMaximize);
-	optimize();
+	ModelEvaluation result;
+	result.row_activity.resize(rowwiseMatrix().num_row_);
+	result.max_infeasibility = evaluate(x, result.row_activity.data(), threads);
+	return result;
 }
 
-HighsSolution OptimizationModel::getSolution() {
-	return highs.getSolution();
+double OptimizationModel::evaluate(const double* x, double* row_activity, int threads)
+{
+	const HighsSparseMatrix& a = rowwiseMatrix();
+	const HighsLp& lp = highs.getLp();
+
+	double worst = 0.0;
+	for (HighsInt c = 0; c < lp.num_col_; ++c)
+		worst = std::max(worst, std::max(lp.col_lower_[c] - x[c], x[c] - lp.col_upper_[c]));
+
+	const double* lower = lp.row_lower_.data();
+	const double* upper = lp.row_upper_.data();
+
+	int chunks = parallelChunks(a.numNz(), threads, kEvaluateNonzeros);
+	if (chunks <= 1)
+		return std::max(worst, evaluateRows(a, lower, upper, x, row_activity, 0, lp.num_row_));
+
+	std::vector<double> chunk_worst(chunks, 0.0);
+	parallelFor(lp.num_row_, chunks, [&](long long begin, long long end, int chunk) {
+		chunk_worst[chunk] = evaluateRows(a, lower, upper, x, row_activity, begin, end);
+	});
+
+	for (double w : chunk_worst)
+		worst = std::max(worst, w);
+	return worst;
 }
 
 void OptimizationModel::computeIIS()
@@ -205,13 +1408,32 @@ void OptimizationModel::computeIIS()
 
 ModelLinearExpression OptimizationModel::getObjective() const
 {
-	return objective;
+	if (!objective_in_highs)
+		return objective;
+
+	// objective of a model adopted from highs, built on request
+	const HighsLp& lp = highs.getLp();
+	ModelLinearExpression obj(lp.offset_);
+
+	for (HighsInt c = 0; c < lp.num_col_; c++)
+		if (lp.col_cost_[c] != 0.0)
+			obj.terms.push_back({ column(c)->ref, lp.col_cost_[c] });
+
+	if (!obj.terms.empty())
+		obj.model = const_cast<OptimizationModel*>(this);
+
+	return obj;
 }
 
 void OptimizationModel::setObjective(ModelLinearExpression obje, ObjSense s)
 {
-	model.reset();
-	objective = obje;
+	if (obje.model != nullptr && obje.model != this)
+		throw std::invalid_argument("obje");
+
+	objective_changed = true;
+	objective_in_highs = false;
+	objective = std::move(obje);
+	objective.dropRemovedVars();
 	sense = s;
 }
 
@@ -219,21 +1441,20 @@ ModelVar OptimizationModel::getVar(int i) const
 {
 	if (i < 0 || i >= columns.size())
 		throw std::invalid_argument("i");
-	return columns[i];
+	return column(i);
 }
 
 ModelConstraint OptimizationModel::getConstr(int i) const
 {
 	if (i < 0 || i >= rows.size())
 		throw std::invalid_argument("i");
-	return rows[i];
+	return row(i);
 }
 
 
 ModelVar OptimizationModel::addVar(double lb, double ub, bool integer, std::string name)
 {
-	model.reset();
-	std::shared_ptr<ModelColumn> newCol(new ModelColumn(this, columns.size(), name));
+	std::shared_ptr<ModelColumn> newCol = newColumn(columns.size(), col_names.add(name));
 
 	newCol->lb = lb;
 	newCol->ub = ub;
@@ -245,46 +1466,341 @@ ModelVar OptimizationModel::addVar(double lb, double ub, bool integer, std::stri
 
 ModelConstraint OptimizationModel::addConstr(ModelLinearExpression expr, std::string name)
 {
-	model.reset();
-	std::shared_ptr<ModelRow> newRow(new ModelRow(this, rows.size(), name));
-	newRow->expr = expr;
+	if (expr.model != nullptr && expr.model != this)
+		throw std::invalid_argument("expr");
+
+	// the terms are moved into the arena
+	std::shared_ptr<ModelRow> row = newRow(rows.size(), row_names.add(name));
+	row->expr = std::move(expr);
+	row->expr.dropRemovedVars();
+
+	rows.push_back(row);
+	return row;
+}
+
+std::vector<ModelVar> OptimizationModel::addBinaries(int size, std::string prefix)
+{
+	std::vector<double> lower(size, 0.0), upper(size, 1.0);
+	std::vector<HighsVarType> integrality(size, HighsVarType::kInteger);
+	std::vector<ModelVar> vars = addVars(size, lower.data(), upper.data(), integrality.data());
+
+	// one interned prefix, the numbered names are only built when requested
+	if (!prefix.empty()) {
+		uint32_t id = col_names.intern(prefix);
+		for (int i = 0; i < size; i++)
+			vars[i].column->name = col_names.add(id, i);
+	}
+
+	return vars;
+}
+
+/// <summary>
+/// True when highs holds exactly the wrapper's columns and rows, so new ones can go
+/// straight to highs without waiting for update().
+/// </summary>
+bool OptimizationModel::inSync() const
+{
+	return synced && removed_cols == 0 && removed_rows == 0 && synced_cols == columns.size() && synced_rows == rows.size();
+}
+
+/// <summary>
+/// Add count variables in one go. Names are optional; continuous and integer are the
+/// supported variable types. On a model already passed to highs the columns are added
+/// with a single Highs::addCols.
+/// </summary>
+std::vector<ModelVar> OptimizationModel::addVars(HighsInt count, const double* lower, const double* upper, const HighsVarType* integrality, const std::string* names)
+{
+	if (count < 0)
+		throw std::invalid_argument("count");
+
+	for (HighsInt i = 0; integrality && i < count; ++i)
+		if (integrality[i] != HighsVarType::kContinuous && integrality[i] != HighsVarType::kInteger)
+			throw std::invalid_argument("integrality");
+
+	bool direct = inSync();
+
+	columns.reserve(columns.size() + count);
+	col_slots.reserve(col_slots.size() + count);
+
+	std::vector<ModelVar> vars;
+	vars.reserve(count);
+
+	for (HighsInt i = 0; i < count; ++i) {
+		std::shared_ptr<ModelColumn> newCol = newColumn(columns.size(), names ? col_names.add(names[i]) : NameTable::none);
+
+		newCol->lb = lower ? lower[i] : 0.0;
+		newCol->ub = upper ? upper[i] : kHighsInf;
+		newCol->integer = integrality && integrality[i] == HighsVarType::kInteger;
+
+		columns.push_back(newCol);
+		vars.push_back(std::move(newCol));
+	}
+
+	if (direct && count > 0) {
+		std::vector<double> lb, ub;
+		std::vector<HighsVarType> type;
+		buildColumns(synced_cols, lb, ub, type);
+
+		std::vector<double> cost(count, 0.0);
+		highs.addCols(count, cost.data(), lb.data(), ub.data(), 0, nullptr, nullptr, nullptr);
+
+		if (integrality)
+			highs.changeColsIntegrality(synced_cols, synced_cols + count - 1, type.data());
+
+		synced_cols = columns.size();
+	}
+
+	return vars;
+}
+
+/// <summary>
+/// Add count constraints lower[i] <= row i <= upper[i] from a row-wise matrix (start has
+/// count entries, column indices refer to the current columns). Rows with two finite bounds
+/// become single ranged rows. On a model already passed to highs the rows go through a single
+/// Highs::addRows.
+/// </summary>
+std::vector<ModelConstraint> OptimizationModel::addConstrs(HighsInt count, const double* lower, const double* upper,
+	HighsInt num_nz, const HighsInt* start, const HighsInt* index, const double* value, const std::string* names)
+{
+	if (count < 0 || num_nz < 0)
+		throw std::invalid_argument("count");
+
+	for (HighsInt k = 0; k < num_nz; ++k)
+		if (index[k] < 0 || index[k] >= columns.size() || column(index[k])->col < 0)
+			throw std::invalid_argument("index");
+
+	bool direct = inSync();
+
+	rows.reserve(rows.size() + count);
+
+	std::vector<ModelConstraint> constrs;
+	constrs.reserve(count);
+
+	for (HighsInt r = 0; r < count; ++r) {
+		std::shared_ptr<ModelRow> row = newRow(rows.size(), names ? row_names.add(names[r]) : NameTable::none);
+		auto& expr = row->expr;
+
+		if (lower[r] == upper[r])
+			expr.setInequality(ModelLinearExpression::Inequality::EQ, lower[r]);
+		else {
+			if (lower[r] > -kHighsInf)
+				expr.setInequality(ModelLinearExpression::Inequality::GE, lower[r]);
+			if (upper[r] < kHighsInf || lower[r] == -kHighsInf)
+				expr.setInequality(ModelLinearExpression::Inequality::LE, upper[r]);
+		}
 
-	rows.push_back(newRow);
-	return newRow;
+		HighsInt end = r + 1 < count ? start[r + 1] : num_nz;
+		expr.model = this;
+		expr.terms.reserve(end - start[r]);
+
+		for (HighsInt k = start[r]; k < end; ++k)
+			expr.terms.push_back({ column(index[k])->ref, value[k] });
+
+		rows.push_back(row);
+		constrs.push_back(std::move(row));
+	}
+
+	if (direct && count > 0) {
+		highs.addRows(count, lower, upper, num_nz, start, index, value);
+		synced_rows = rows.size();
+		row_matrix_valid = false;
+	}
+
+	return constrs;
 }
 
+/// <summary>
+/// Queue a variable for removal. Its handle reports index -1 straight away, the remaining
+/// columns keep their indices until the next update() compacts them. Terms referencing a
+/// removed variable are dropped from the model's rows and objective, and ignored when an
+/// expression holding them is added later.
+/// </summary>
 void OptimizationModel::remove(ModelVar v)
 {
-	throw std::logic_error("not implemented");
+	if (!v.column || v.column->model != this)
+		throw std::invalid_argument("v");
+
+	if (v.column->col >= 0) {
+		// retire the slot straight away so expressions see the removal
+		auto& slot = col_slots[v.column->ref.id];
+		slot.col = -1;
+		++slot.gen;
+		free_col_slots.push_back(v.column->ref.id);
+
+		v.column->col = -1;
+		++removed_cols;
+	}
 }
 
+/// <summary>
+/// Queue a constraint for removal, see remove(ModelVar).
+/// </summary>
 void OptimizationModel::remove(ModelConstraint c)
 {
-	throw std::logic_error("not implemented");
+	if (!c.row || c.row->model != this)
+		throw std::invalid_argument("c");
+
+	if (c.row->row >= 0) {
+		c.row->row = -1;
+		++removed_rows;
+	}
+}
+
+void ModelVar::remove()
+{
+	if (column)
+		column->model->remove(*this);
+}
+
+void ModelConstraint::remove()
+{
+	if (row)
+		row->model->remove(*this);
+}
+
+/// <summary>
+/// Position of the variable in the row's terms, or -1. The row is compressed and indexed
+/// by column slot on first use, so later lookups are O(1). Adopted rows are mirrored from
+/// highs first.
+/// </summary>
+HighsInt OptimizationModel::termPosition(ModelRow& row, ModelVarRef ref) const
+{
+	if (!row.indexed) {
+		if (row.adopted && !row.mirrored)
+			mirrorRow(row);
+
+		row.expr.compress();
+		row.position.clear();
+		row.position.reserve(row.expr.terms.size());
+
+		for (uint32_t i = 0; i < row.expr.terms.size(); ++i)
+			row.position.emplace(row.expr.terms[i].var.id, i);
+
+		row.indexed = true;
+	}
+
+	auto it = row.position.find(ref.id);
+	if (it == row.position.end() || !(row.expr.terms[it->second].var == ref))
+		return -1;
+
+	return it->second;
+}
+
+/// <summary>
+/// Copy the terms of an adopted row from highs into its expression, so lookups on rows from
+/// a copy, a file or a row builder are as fast as on rows built from expressions.
+/// </summary>
+void OptimizationModel::mirrorRow(ModelRow& row) const
+{
+	HighsInt r = row.row, num_row, num_nz;
+	highs.getRows(r, r, num_row, nullptr, nullptr, num_nz, nullptr, nullptr, nullptr);
+
+	HighsInt start = 0;
+	std::vector<HighsInt> index(num_nz);
+	std::vector<double> value(num_nz);
+	highs.getRows(r, r, num_row, nullptr, nullptr, num_nz, &start, index.data(), value.data());
+
+	auto& terms = row.expr.terms;
+	terms.clear();
+	terms.reserve(num_nz);
+	for (HighsInt k = 0; k < num_nz; ++k)
+		terms.push_back({ column(index[k])->ref, value[k] });
+
+	row.expr.setModel(const_cast<OptimizationModel*>(this));
+	row.mirrored = true;
+}
+
+/// <summary>
+/// Position of column col in the streamed row, or -1, indexed on first use like termPosition.
+/// </summary>
+HighsInt OptimizationModel::streamedPosition(ModelRow& row, HighsInt col) const
+{
+	HighsInt first = streamed.start[row.streamed];
+
+	if (!row.indexed) {
+		HighsInt end = streamed.start[row.streamed + 1];
+		row.position.clear();
+		row.position.reserve(end - first);
+
+		for (HighsInt k = first; k < end; ++k)
+			row.position.emplace(streamed.index[k], k - first);
+
+		row.indexed = true;
+	}
+
+	auto it = row.position.find(col);
+	return it == row.position.end() ? -1 : first + it->second;
 }
 
+/// <summary>
+/// Set the coefficient of v in c, a zero value removes the term. Rows and columns
+/// already in highs are changed there through Highs::changeCoeff.
+/// </summary>
 void OptimizationModel::chgCoeff(ModelConstraint c, ModelVar v, double val)
 {
-	throw std::logic_error("not implemented");
+	if (!c.row || c.row->model != this || c.index() < 0)
+		throw std::invalid_argument("c");
+
+	if (!v.column || v.column->model != this || v.index() < 0)
+		throw std::invalid_argument("v");
+
+	ModelRow& row = *c.row;
+
+	// a streamed row is changed once it is in highs
+	if (row.streamed >= 0)
+		update();
+
+	// the terms of adopted rows are in highs, termPosition mirrors them on first use
+	auto& terms = row.expr.terms;
+	HighsInt p = termPosition(row, v.column->ref);
+
+	if (p < 0) {
+		if (val != 0.0) {
+			// the slot may still be indexed for a removed column it held before
+			row.position[v.column->ref.id] = terms.size();
+			row.expr.setModel(this);
+			terms.push_back({ v.column->ref, val });
+		}
+	}
+	else if (val != 0.0) {
+		terms[p].coeff = val;
+	}
+	else {
+		// swap the last term into the gap
+		row.position.erase(terms[p].var.id);
+		if (p + 1 < terms.size()) {
+			terms[p] = terms.back();
+			row.position[terms[p].var.id] = p;
+		}
+		terms.pop_back();
+	}
 
-	//int i = c.getrowno();
-	//int j = v.getcolno();
-	//if (i < 0 || j < 0) 
-	//	throw std::invalid_argument("c or v");
+	if (c.index() < synced_rows) {
+		// the column has to exist in highs before the row can refer to it
+		if (v.index() >= synced_cols)
+			update();
 
-	//highs.changeCoeff(i, j, val);
+		highs.changeCoeff(c.index(), v.index(), val);
+		row_matrix_valid = false;
+		++revision;
+	}
 }
 
 double OptimizationModel::getCoeff(ModelConstraint c, ModelVar v) const
 {
-	throw std::logic_error("not implemented");
+	if (!c.row || c.row->model != this || c.index() < 0)
+		throw std::invalid_argument("c");
 
-	//int i = c.getrowno();
-	//int j = v.getcolno();
-	//if (i < 0 || i >= rows || j < 0 || j >= cols) 
-	//	throw std::invalid_argument("c or v");
+	if (!v.column || v.column->model != this || v.index() < 0)
+		throw std::invalid_argument("v");
+
+	if (c.row->streamed >= 0) {
+		HighsInt k = streamedPosition(*c.row, v.index());
+		return k < 0 ? 0.0 : streamed.value[k];
+	}
 
-	//throw std::logic_error("not implemented");
+	HighsInt p = termPosition(*c.row, v.column->ref);
+	return p < 0 ? 0.0 : c.row->expr.terms[p].coeff;
 }
 
 ModelLinearExpression OptimizationModel::getRow(ModelConstraint c)
@@ -292,9 +1808,121 @@ ModelLinearExpression OptimizationModel::getRow(ModelConstraint c)
 	if (c.index() < 0 || c.index() >= rows.size())
 		throw std::invalid_argument("c");
 
+	if (c.row->streamed >= 0) {
+		ModelLinearExpression expr = c.row->expr;
+		for (HighsInt k = streamed.start[c.row->streamed]; k < streamed.start[c.row->streamed + 1]; ++k)
+			expr += streamed.value[k] * ModelVar(column(streamed.index[k]));
+
+		return expr;
+	}
+
+	// rows adopted from highs keep their coefficients there, unless they were mirrored
+	if (c.row->adopted && !c.row->mirrored) {
+		HighsInt r = c.index(), num_row, num_nz;
+		highs.getRows(r, r, num_row, nullptr, nullptr, num_nz, nullptr, nullptr, nullptr);
+
+		std::vector<HighsInt> start(1), index(num_nz);
+		std::vector<double> value(num_nz);
+		highs.getRows(r, r, num_row, nullptr, nullptr, num_nz, start.data(), index.data(), value.data());
+
+		ModelLinearExpression expr = c.row->expr;
+		for (HighsInt k = 0; k < num_nz; ++k)
+			expr += value[k] * ModelVar(column(index[k]));
+
+		return expr;
+	}
+
 	return c.row->expr;
 }
 
+ModelRowBuilder::ModelRowBuilder(OptimizationModel* model) : model(model), open(true)
+{
+	if (model->row_builder_open)
+		throw std::logic_error("another row builder is open");
+
+	model->row_builder_open = true;
+}
+
+ModelRowBuilder::~ModelRowBuilder()
+{
+	if (!open)
+		return;
+
+	// take back the terms of a row that was never committed
+	auto& streamed = model->streamed;
+	streamed.index.resize(streamed.start.back());
+	streamed.value.resize(streamed.start.back());
+	model->row_builder_open = false;
+}
+
+ModelRowBuilder& ModelRowBuilder::add(ModelVar v, double coeff)
+{
+	if (!open)
+		throw std::logic_error("row builder was moved");
+
+	model->streamTerm(v, coeff);
+	return *this;
+}
+
+ModelConstraint ModelRowBuilder::commit(double lower, double upper, const std::string& name)
+{
+	if (!open)
+		throw std::logic_error("row builder was moved");
+
+	return model->streamCommit(lower, upper, name);
+}
+
+void OptimizationModel::streamTerm(ModelVar v, double coeff)
+{
+	if (!v.column || v.column->model != this || v.index() < 0)
+		throw std::invalid_argument("v");
+
+	if (coeff == 0.0)
+		return;
+
+	HighsInt col = v.index();
+	if (col >= streamed_mark.size())
+		streamed_mark.resize(columns.size(), -1);
+
+	// a column added again to the open row has its coefficients summed
+	HighsInt k = streamed_mark[col];
+	if (k >= streamed.start.back() && k < streamed.index.size() && streamed.index[k] == col) {
+		streamed.value[k] += coeff;
+		if (streamed.value[k] != 0.0)
+			return;
+
+		// cancelled out, the last term of the row takes its place
+		streamed.index[k] = streamed.index.back();
+		streamed.value[k] = streamed.value.back();
+		streamed_mark[streamed.index[k]] = k;
+		streamed.index.pop_back();
+		streamed.value.pop_back();
+		return;
+	}
+
+	streamed_mark[col] = streamed.index.size();
+	streamed.index.push_back(col);
+	streamed.value.push_back(coeff);
+}
+
+/// <summary>
+/// Close the open row of the builder as a new constraint. The row only lives in the streamed
+/// matrix until update() passes it to highs, after that it is an adopted row.
+/// </summary>
+ModelConstraint OptimizationModel::streamCommit(double lower, double upper, const std::string& name)
+{
+	std::shared_ptr<ModelRow> row = newRow(rows.size(), row_names.add(name));
+	row->adopted = true;
+	row->streamed = streamed.lower.size();
+
+	streamed.lower.push_back(lower);
+	streamed.upper.push_back(upper);
+	streamed.start.push_back(streamed.index.size());
+
+	rows.push_back(row);
+	return row;
+}
+
 string OptimizationModel::getJSONSolution(void)
 {
 	throw std::logic_error("not implemented");
@@ -7,43 +7,203 @@
 
 #include "var.h"
 #include "constraint.h"
+#include "name_table.h"
+#include "scenario.h"
+#include "row_builder.h"
+#include "value_span.h"
+#include "evaluate.h"
+#include "snapshot.h"
+#include "relaxation.h"
 
 class OptimizationModel
 {
   private:
+    friend class ModelLinearExpression;
+    friend class ModelVar;
+    friend class ModelConstraint;
+    friend class ModelRowBuilder;
+    friend class ModelRelaxation;
+
+    // storage of columns, rows and row terms, handles share ownership of it
+    std::shared_ptr<ModelArena> arena = std::make_shared<ModelArena>();
+
+    // null entries exist only in highs until their handle is first requested
     std::vector<std::shared_ptr<ModelRow>> rows;
     std::vector<std::shared_ptr<ModelColumn>> columns;
 
+    // expressions refer to columns through stable slots, col is -1 once removed
+    struct ColumnSlot { HighsInt col; uint32_t gen; };
+    std::vector<ColumnSlot> col_slots;
+    std::vector<uint32_t> free_col_slots;
+
+    // names given through the wrapper, models read from file keep theirs in highs
+    NameTable col_names;
+    NameTable row_names;
+
     ModelLinearExpression objective;
-    ObjSense sense;
-    
-    std::unique_ptr<HighsModel> model;
+    ObjSense sense = ObjSense::kMinimize;
+    bool objective_in_highs = false;
+
+    // number of columns/rows already passed to highs, everything beyond is pending
+    HighsInt synced_cols = 0;
+    HighsInt synced_rows = 0;
+    bool synced = false;
+    bool objective_changed = true;
+
+    // threads used to assemble the matrix, 0 uses all hardware threads
+    int assembly_threads = 0;
+
+    // accumulators of compress() for each chunk of rows in update(), reused across updates
+    std::vector<std::vector<HighsInt>> compress_scratch;
+
+  public:
+    // orientation of the matrix passed to highs, Auto goes column-wise from kColwiseNonzeros
+    enum class AssemblyFormat { Auto, Rowwise, Colwise };
+    static const size_t kColwiseNonzeros = 1000000;
+
+    // nonzeros per thread of evaluate(), smaller matrices are evaluated on the calling thread
+    static const long long kEvaluateNonzeros = 65536;
+
+  private:
+    AssemblyFormat assembly_format = AssemblyFormat::Auto;
+
+    // removals are queued and applied in one batch by the next update()
+    HighsInt removed_cols = 0;
+    HighsInt removed_rows = 0;
+
+    // rows committed through rowBuilder() and not yet in highs, row-wise with column indices
+    // so update() can hand them on as they are. Terms past start.back() belong to the row
+    // of the open builder.
+    struct StreamedRows
+    {
+        std::vector<double> lower, upper;
+        std::vector<HighsInt> start = { 0 };
+        std::vector<HighsInt> index;
+        std::vector<double> value;
+    };
+    StreamedRows streamed;
+    bool row_builder_open = false;
+
+    // position of each column in the streamed arrays when it was last added, which is its
+    // entry in the open row if that position is in the row and holds the column
+    std::vector<HighsInt> streamed_mark;
+
+    // row-wise copy of a column-wise matrix in highs for evaluate(), dropped when the matrix changes
+    HighsSparseMatrix row_matrix;
+    bool row_matrix_valid = false;
+
+    // basis and solution taken from highs before removals or a MIP solve drop them, by position.
+    // Removals compact them like the columns and rows, so the next solve starts from them.
+    struct WarmStart
+    {
+        std::vector<HighsBasisStatus> col_status, row_status;
+        std::vector<double> col_value, row_dual;
+        bool basis = false;
+        bool solution = false;
+        bool changed = false;   // columns or rows were added or removed since the solve
+    };
+    WarmStart warm;
+    bool warm_start = true;
+
+    // counts changes to highs other than appended columns and rows and the objective,
+    // a ModelRelaxation passes the model anew when it moved
+    uint64_t revision = 0;
 
-    OptimizationModel(const HighsModel& m);
+    // set on models returned by presolve(), postsolve() maps their solution back onto it
+    OptimizationModel* original = nullptr;
+
+    OptimizationModel(const HighsModel& m, OptimizationModel* original = nullptr);
     ModelConstraint addConstr(const ModelLinearExpression&  expr, char sense, double lhs, double rhs, const std::string& cname);
     ModelVar addVar(double lb, double ub, bool integer, std::string name);
 
+    std::shared_ptr<ModelColumn> newColumn(HighsInt col, uint32_t name = NameTable::none);
+    std::shared_ptr<ModelRow> newRow(HighsInt row, uint32_t name = NameTable::none);
+    const std::shared_ptr<ModelColumn>& column(HighsInt c) const;
+    const std::shared_ptr<ModelRow>& row(HighsInt r) const;
+    void viewHighs();
+    std::string colName(const ModelColumn& column) const;
+    std::string rowName(const ModelRow& row) const;
+    void passNames();
+    HighsInt colIndex(ModelVarRef ref) const { const auto& slot = col_slots[ref.id]; return slot.gen == ref.gen ? slot.col : -1; }
+
+    void buildColumns(HighsInt from, std::vector<double>& lower, std::vector<double>& upper, std::vector<HighsVarType>& integrality) const;
+    static void rowBounds(const ModelLinearExpression& expr, double& lower, double& upper);
+    void rowBounds(const ModelRow& row, double& lower, double& upper) const;
+    size_t rowLength(const ModelRow& row) const;
+    void buildColwise(std::vector<double>& lower, std::vector<double>& upper, std::vector<HighsInt>& start, std::vector<HighsInt>& index, std::vector<double>& value) const;
+    void buildRows(HighsInt from, std::vector<double>& lower, std::vector<double>& upper, std::vector<HighsInt>& start, std::vector<HighsInt>& index, std::vector<double>& value) const;
+    void buildCost(std::vector<double>& cost) const;
+    void assembleColumns(HighsModel& model) const;
+    void applyRemovals();
+    void remapStreamed(const std::vector<HighsInt>& remap);
+    bool streamedOnly() const;
+    void releaseStreamed();
+    void streamTerm(ModelVar v, double coeff);
+    ModelConstraint streamCommit(double lower, double upper, const std::string& name);
+    HighsInt termPosition(ModelRow& row, ModelVarRef ref) const;
+    HighsInt streamedPosition(ModelRow& row, HighsInt col) const;
+    void mirrorRow(ModelRow& row) const;
+    void captureWarmStart();
+    void applyWarmStart();
+    void solveScenario(Highs& h, const ModelScenario& scenario, ScenarioResult& result, bool primal) const;
+    bool inSync() const;
+    bool pendingChanges() const;
+    const HighsSparseMatrix& rowwiseMatrix();
+
   public:
     Highs highs;
 
-    OptimizationModel() : sense(ObjSense::kMinimize) { }
+    OptimizationModel() { }
     OptimizationModel(const std::string& filename);
     OptimizationModel(const OptimizationModel& xmodel);
 
     void read(const std::string& filename);
     void write(const std::string& filename);
 
+    // binary image of the model, see ModelSnapshotHeader. Loading maps the file and copies
+    // its arrays into highs without parsing, the basis is restored when one was saved.
+    void readSnapshot(const std::string& filename);
+    void writeSnapshot(const std::string& filename, bool names = true, bool basis = true);
+
+    // copy of this model without integrality
     OptimizationModel relax();
+
+    // LP relaxation kept in step with this model on its own highs, see ModelRelaxation
+    ModelRelaxation relaxation() { return ModelRelaxation(this); }
+
+    // the reduced model is solved like any other, postsolve() then maps its solution and
+    // basis back onto this model. Valid while this model is alive and left unchanged.
     OptimizationModel presolve();
+    void postsolve();
 
     void update();
+    // the model as update() first passes it to highs, throws std::logic_error once it has
+    void assemble(HighsModel& model) const;
+    void setAssemblyThreads(int threads) { assembly_threads = threads; }
+    void setAssemblyFormat(AssemblyFormat format) { assembly_format = format; }
     void optimize();
 
+    // re-solves after adding or removing columns and rows start from the last basis and
+    // solution, mapped onto the changed model: new rows are basic, new columns at a bound
+    void setWarmStart(bool enabled) { warm_start = enabled; warm = WarmStart(); }
+
+    // solve every scenario as a variant of this model, see ModelScenario. highs is left with
+    // the basis and solution of the last scenario its thread solved.
+    std::vector<ScenarioResult> solveBatch(const std::vector<ModelScenario>& scenarios, bool primal = false, int threads = 1);
+
     void minimize(ModelLinearExpression obj);
     void maximize(ModelLinearExpression obj);
 
     void computeIIS();
 
+    // activities of all rows at x, given for every column, and the largest violation of a
+    // row or column bound. Rows are split over up to threads threads, 0 uses all hardware
+    // threads, each with at least kEvaluateNonzeros nonzeros.
+    // The second form writes the activities to row_activity, which may be null, and
+    // allocates nothing once the matrix is cached.
+    ModelEvaluation evaluate(const double* x, int threads = 1);
+    double evaluate(const double* x, double* row_activity, int threads = 1);
+
     ModelLinearExpression getObjective() const;
     void setObjective(ModelLinearExpression obje, ObjSense sense=ObjSense::kMinimize);
 
@@ -54,19 +214,25 @@ class OptimizationModel
     ModelVar addIntegral(double lb=0, double ub=kHighsInf, std::string name="") { return addVar(lb, ub, true, name); }
     ModelVar addBinary(std::string name="") { return addVar(0, 1, true, name); }
 
-    std::vector<ModelVar> addBinaries(int size, std::string prefix="") 
-    {
-        std::vector<ModelVar> vars;
-        
-        for (int i = 0; i < size; i++)
-			vars.push_back(addBinary(prefix + std::to_string(i)));
-
-        return std::move(vars); 
-    }
+    // names are only generated when a prefix is given
+    std::vector<ModelVar> addBinaries(int size, std::string prefix="");
 
+    // bulk creation, lower/upper default to [0, inf) when null
+    std::vector<ModelVar> addVars(HighsInt count, const double* lower, const double* upper, const HighsVarType* integrality = nullptr, const std::string* names = nullptr);
 
     ModelConstraint addConstr(ModelLinearExpression expr, std::string name="");
 
+    // comparisons of expression templates are evaluated straight into the new row
+    template <typename E>
+    ModelConstraint addConstr(const ModelCompareNode<E>& c, std::string name="");
+
+    // bulk creation from a row-wise matrix in the layout of Highs::addRows, indices are column indices
+    std::vector<ModelConstraint> addConstrs(HighsInt count, const double* lower, const double* upper,
+        HighsInt num_nz, const HighsInt* start, const HighsInt* index, const double* value, const std::string* names = nullptr);
+
+    // streams rows straight into the matrix passed to highs, see ModelRowBuilder
+    ModelRowBuilder rowBuilder() { return ModelRowBuilder(this); }
+
     void remove(ModelVar v);
     void remove(ModelConstraint c);
 
@@ -76,7 +242,32 @@ class OptimizationModel
     //std::vector<ModelLinearExpression> getCol(ModelVar v);
     ModelLinearExpression getRow(ModelConstraint c);
 
-    HighsSolution getSolution();
+    const HighsSolution& getSolution() const { return highs.getSolution(); }
+
+    // values of the last solve, read in place; throw std::logic_error when there is no
+    // solution or the variable or constraint was added after it
+    double getValue(ModelVar v) const;
+    double getValue(const ModelLinearExpression& expr) const;
+    double getDual(ModelConstraint c) const;
+
+    // views of the whole solution, valid until the next solve or model change
+    ModelValueSpan colValues() const;
+    ModelValueSpan rowValues() const;
+    ModelValueSpan rowDuals() const;
 
     std::string getJSONSolution(void);
 };
+
+template <typename E>
+ModelConstraint OptimizationModel::addConstr(const ModelCompareNode<E>& c, std::string name)
+{
+    if (c.expr.owner() != nullptr && c.expr.owner() != this)
+        throw std::invalid_argument("c");
+
+    std::shared_ptr<ModelRow> row = newRow(rows.size(), row_names.add(name));
+    c.evaluate(row->expr);
+    row->expr.dropRemovedVars();
+
+    rows.push_back(row);
+    return row;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Number of chunks to split count items into: at most threads (0 = all hardware threads),
+/// and no chunk smaller than grain items.
+/// </summary>
+inline int parallelChunks(long long count, int threads, long long grain = 4096)
+{
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return (int)std::max(1LL, std::min<long long>(threads, count / grain));
+}
+
+/// <summary>
+/// Run f(begin, end, chunk) over [0, count) split into chunks contiguous ranges, one thread
+/// per chunk. The split only depends on count and chunks, so passes over the same data with
+/// the same chunk count see the same ranges.
+/// </summary>
+template <typename F>
+void parallelFor(long long count, int chunks, F f)
+{
+    auto begin = [&](int chunk) { return count * chunk / chunks; };
+
+    if (chunks <= 1) {
+        f(0LL, count, 0);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    pool.reserve(chunks - 1);
+
+    for (int chunk = 1; chunk < chunks; ++chunk)
+        pool.emplace_back([&f, chunk, b = begin(chunk), e = begin(chunk + 1)]() { f(b, e, chunk); });
+
+    f(0LL, begin(1), 0);
+
+    for (auto& thread : pool)
+        thread.join();
+}
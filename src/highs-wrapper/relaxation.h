@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+#include "highs/Highs.h"
+
+#include "var.h"
+
+class OptimizationModel;
+
+/// <summary>
+/// The LP relaxation of a model, solved on its own highs so the model stays the MIP:
+/// m.relaxation() passes the model's LP without integrality once, and each optimize()
+/// then only adds the columns and rows the model appended since and copies the costs.
+/// Other changes to the model pass it anew. Solves start from the view's last basis, or
+/// the model's when one exists. Changes made to m.highs directly aren't seen.
+/// The model has to outlive the view.
+/// </summary>
+class ModelRelaxation
+{
+  private:
+    OptimizationModel* model;
+    uint64_t revision;  // of the model when it was last passed
+
+    void pass();
+    void sync();
+
+  public:
+    Highs highs;
+
+    ModelRelaxation(OptimizationModel* model);
+    ModelRelaxation(const ModelRelaxation&) = delete;
+
+    void optimize();
+
+    const HighsSolution& getSolution() const { return highs.getSolution(); }
+    HighsModelStatus getModelStatus() const { return highs.getModelStatus(); }
+    double getObjectiveValue() const { return highs.getInfo().objective_function_value; }
+
+    // value of v at the last relaxed solve, throws std::logic_error when there is none
+    double getValue(ModelVar v) const;
+};
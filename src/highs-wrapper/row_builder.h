@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+#include "var.h"
+#include "constraint.h"
+
+class OptimizationModel;
+
+/// <summary>
+/// Streams one constraint at a time straight into the model's row-wise matrix, without
+/// building an expression: m.rowBuilder().add(x, 3.0).add(y, -1.0).commit(0, 10).
+/// A column added twice to a row has its coefficients summed. Only one builder per model
+/// can be open at a time, a builder dropped without commit() takes its terms back out.
+/// </summary>
+class ModelRowBuilder
+{
+  private:
+    OptimizationModel* model;
+    bool open;
+
+  public:
+    friend class OptimizationModel;
+
+    ModelRowBuilder(OptimizationModel* model);
+    ModelRowBuilder(const ModelRowBuilder&) = delete;
+    ModelRowBuilder(ModelRowBuilder&& b) : model(b.model), open(b.open) { b.open = false; }
+    ~ModelRowBuilder();
+
+    ModelRowBuilder& add(ModelVar v, double coeff);
+
+    // lower <= row <= upper, the builder can then be used for the next row
+    ModelConstraint commit(double lower, double upper, const std::string& name = "");
+};
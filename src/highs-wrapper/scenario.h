@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+
+#include "var.h"
+#include "constraint.h"
+
+/// <summary>
+/// A variant of a model for OptimizationModel::solveBatch: row bounds, column bounds and
+/// costs that replace the model's values for one solve. Anything not set keeps the
+/// model's value.
+/// </summary>
+class ModelScenario
+{
+  private:
+    struct RowBounds { ModelConstraint row; double lower, upper; };
+    struct ColBounds { ModelVar col; double lower, upper; };
+    struct Cost { ModelVar col; double cost; };
+
+    std::vector<RowBounds> row_bounds;
+    std::vector<ColBounds> col_bounds;
+    std::vector<Cost> costs;
+
+  public:
+    friend class OptimizationModel;
+
+    void setBounds(ModelConstraint c, double lower, double upper) { row_bounds.push_back({ c, lower, upper }); }
+    void setBounds(ModelVar v, double lower, double upper) { col_bounds.push_back({ v, lower, upper }); }
+    void setCost(ModelVar v, double cost) { costs.push_back({ v, cost }); }
+
+    void clear() {
+        row_bounds.clear();
+        col_bounds.clear();
+        costs.clear();
+    }
+};
+
+/// <summary>
+/// Outcome of one scenario. col_value is only filled when the batch asks for primal values.
+/// </summary>
+struct ScenarioResult
+{
+    HighsModelStatus status = HighsModelStatus::kNotset;
+    double objective = 0.0;
+    std::vector<double> col_value;
+};
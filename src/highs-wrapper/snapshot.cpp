@@ -0,0 +1,357 @@
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "snapshot.h"
+
+static const char kSnapshotMagic[8] = { 'H', 'W', 'S', 'N', 'A', 'P', 0, 0 };
+
+static size_t padded(size_t bytes)
+{
+	return (bytes + 7) & ~size_t(7);
+}
+
+/// <summary>
+/// Read-only mapping of a whole file, unmapped when it goes out of scope.
+/// </summary>
+class MappedFile
+{
+  private:
+	const char* base = nullptr;
+	size_t length = 0;
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+  public:
+	MappedFile(const std::string& filename)
+	{
+#if defined(_WIN32)
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER size;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+			throw std::runtime_error("cannot open " + filename);
+
+		length = size.QuadPart;
+		if (length == 0)
+			return;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr)
+			base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			if (fd >= 0)
+				close(fd);
+			throw std::runtime_error("cannot open " + filename);
+		}
+
+		length = st.st_size;
+		if (length == 0) {
+			close(fd);
+			return;
+		}
+
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if (p != MAP_FAILED) {
+			base = (const char*)p;
+			// the arrays are copied out front to back
+			madvise(p, length, MADV_SEQUENTIAL);
+		}
+#endif
+		if (base == nullptr) {
+			release();
+			throw std::runtime_error("cannot map " + filename);
+		}
+	}
+
+	~MappedFile() { release(); }
+
+	void release()
+	{
+#if defined(_WIN32)
+		if (base)
+			UnmapViewOfFile(base);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (base)
+			munmap((void*)base, length);
+#endif
+		base = nullptr;
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return base; }
+	size_t size() const { return length; }
+};
+
+/// <summary>
+/// Walks the sections of a mapped snapshot in the order they were written.
+/// </summary>
+struct SnapshotReader
+{
+	const char* data;
+	size_t size;
+	size_t pos;
+
+	const char* take(size_t bytes)
+	{
+		if (bytes > size - pos)
+			throw std::runtime_error("snapshot is truncated");
+
+		const char* p = data + pos;
+		pos += padded(bytes);
+		if (pos > size)
+			pos = size;
+		return p;
+	}
+
+	// count items of T, checked before multiplying so a corrupt count cannot wrap around
+	template <typename T>
+	const T* take(size_t count)
+	{
+		if (count > (size - pos) / sizeof(T))
+			throw std::runtime_error("snapshot is truncated");
+
+		return (const T*)take(count * sizeof(T));
+	}
+
+	template <typename T>
+	void read(std::vector<T>& v, size_t count)
+	{
+		const T* p = take<T>(count);
+		v.assign(p, p + count);
+	}
+};
+
+/// <summary>
+/// Pieces of the file in write order, each padded to 8 bytes when written.
+/// </summary>
+struct SnapshotWriter
+{
+	struct Piece { const void* data; size_t bytes; bool pad; };
+	std::vector<Piece> pieces;
+	size_t size = 0;
+
+	void add(const void* data, size_t bytes, bool pad = true)
+	{
+		pieces.push_back({ data, bytes, pad });
+		size += pad ? padded(bytes) : bytes;
+	}
+
+	template <typename T>
+	void add(const std::vector<T>& v) { add(v.data(), v.size() * sizeof(T)); }
+};
+
+void writeModelSnapshot(const std::string& filename, const HighsLp& lp, bool names, const HighsBasis* basis)
+{
+	const HighsSparseMatrix& a = lp.a_matrix_;
+	bool colwise = a.isColwise();
+	size_t num_col = lp.num_col_, num_row = lp.num_row_;
+	size_t num_major = colwise ? num_col : num_row;
+	size_t num_nz = a.start_.size() > num_major ? a.start_[num_major] : 0;
+
+	if (a.start_.size() < num_major + 1 && num_major > 0)
+		throw std::invalid_argument("lp");
+
+	ModelSnapshotHeader header = {};
+	memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+	header.version = ModelSnapshotHeader::kVersion;
+	header.int_size = sizeof(HighsInt);
+	header.num_col = num_col;
+	header.num_row = num_row;
+	header.num_nz = num_nz;
+	header.sense = (int32_t)lp.sense_;
+	header.offset = lp.offset_;
+
+	if (colwise)
+		header.flags |= ModelSnapshotHeader::kColwise;
+
+	bool integrality = lp.integrality_.size() == num_col && num_col > 0;
+	names = names && lp.col_names_.size() == num_col && lp.row_names_.size() == num_row && num_col + num_row > 0;
+	bool with_basis = basis && basis->valid && basis->col_status.size() == num_col && basis->row_status.size() == num_row;
+
+	if (integrality)
+		header.flags |= ModelSnapshotHeader::kIntegrality;
+	if (names)
+		header.flags |= ModelSnapshotHeader::kNames;
+	if (with_basis)
+		header.flags |= ModelSnapshotHeader::kBasis;
+
+	SnapshotWriter out;
+	out.add(&header, sizeof(header));
+
+	out.add(lp.col_cost_.data(), num_col * sizeof(double));
+	out.add(lp.col_lower_.data(), num_col * sizeof(double));
+	out.add(lp.col_upper_.data(), num_col * sizeof(double));
+	out.add(lp.row_lower_.data(), num_row * sizeof(double));
+	out.add(lp.row_upper_.data(), num_row * sizeof(double));
+
+	// an empty matrix may come without its start array
+	std::vector<HighsInt> empty_start(num_major + 1, 0);
+	out.add(num_nz > 0 ? a.start_.data() : empty_start.data(), (num_major + 1) * sizeof(HighsInt));
+	out.add(a.index_.data(), num_nz * sizeof(HighsInt));
+	out.add(a.value_.data(), num_nz * sizeof(double));
+
+	if (integrality)
+		out.add(lp.integrality_.data(), num_col * sizeof(HighsVarType));
+
+	// lengths of the column then row names, followed by their characters back to back
+	std::vector<uint32_t> lengths;
+	if (names) {
+		lengths.reserve(num_col + num_row);
+		for (const auto& name : lp.col_names_)
+			lengths.push_back(name.size());
+		for (const auto& name : lp.row_names_)
+			lengths.push_back(name.size());
+
+		out.add(lengths);
+
+		size_t chars = 0;
+		for (const auto& name : lp.col_names_) {
+			out.add(name.data(), name.size(), false);
+			chars += name.size();
+		}
+		for (const auto& name : lp.row_names_) {
+			out.add(name.data(), name.size(), false);
+			chars += name.size();
+		}
+
+		out.add(nullptr, padded(chars) - chars, false);
+	}
+
+	if (with_basis) {
+		out.add(basis->col_status.data(), num_col * sizeof(HighsBasisStatus));
+		out.add(basis->row_status.data(), num_row * sizeof(HighsBasisStatus));
+	}
+
+	header.size = out.size;
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == nullptr)
+		throw std::runtime_error("cannot open " + filename);
+
+	static const char zeros[8] = {};
+	bool ok = true;
+
+	for (const auto& piece : out.pieces) {
+		size_t pad = piece.pad ? padded(piece.bytes) - piece.bytes : 0;
+
+		if (piece.data)
+			ok = ok && fwrite(piece.data, 1, piece.bytes, file) == piece.bytes;
+		else
+			pad += piece.bytes;
+
+		ok = ok && fwrite(zeros, 1, pad, file) == pad;
+	}
+
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		throw std::runtime_error("cannot write " + filename);
+}
+
+void readModelSnapshot(const std::string& filename, HighsLp& lp, HighsBasis& basis)
+{
+	MappedFile file(filename);
+	SnapshotReader in = { file.data(), file.size(), 0 };
+
+	ModelSnapshotHeader header;
+	memcpy(&header, in.take(sizeof(header)), sizeof(header));
+
+	if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0)
+		throw std::runtime_error(filename + " is not a model snapshot");
+
+	if (header.version != ModelSnapshotHeader::kVersion || header.int_size != sizeof(HighsInt))
+		throw std::runtime_error(filename + " was written by an incompatible version");
+
+	if (header.size > file.size() || header.num_col < 0 || header.num_row < 0 || header.num_nz < 0)
+		throw std::runtime_error("snapshot is truncated");
+
+	const int64_t max_int = std::numeric_limits<HighsInt>::max();
+	if (header.num_col > max_int || header.num_row > max_int || header.num_nz > max_int)
+		throw std::runtime_error("snapshot is corrupt");
+
+	size_t num_col = header.num_col, num_row = header.num_row, num_nz = header.num_nz;
+	bool colwise = header.flags & ModelSnapshotHeader::kColwise;
+	size_t num_major = colwise ? num_col : num_row;
+
+	lp.num_col_ = num_col;
+	lp.num_row_ = num_row;
+	lp.sense_ = (ObjSense)header.sense;
+	lp.offset_ = header.offset;
+
+	in.read(lp.col_cost_, num_col);
+	in.read(lp.col_lower_, num_col);
+	in.read(lp.col_upper_, num_col);
+	in.read(lp.row_lower_, num_row);
+	in.read(lp.row_upper_, num_row);
+
+	HighsSparseMatrix& a = lp.a_matrix_;
+	a.format_ = colwise ? MatrixFormat::kColwise : MatrixFormat::kRowwise;
+	a.num_col_ = num_col;
+	a.num_row_ = num_row;
+	in.read(a.start_, num_major + 1);
+	in.read(a.index_, num_nz);
+	in.read(a.value_, num_nz);
+
+	if (a.start_[0] != 0 || a.start_[num_major] != (HighsInt)num_nz)
+		throw std::runtime_error("snapshot is corrupt");
+
+	if (header.flags & ModelSnapshotHeader::kIntegrality)
+		in.read(lp.integrality_, num_col);
+	else
+		lp.integrality_.clear();
+
+	lp.col_names_.clear();
+	lp.row_names_.clear();
+
+	if (header.flags & ModelSnapshotHeader::kNames) {
+		const uint32_t* lengths = in.take<uint32_t>(num_col + num_row);
+
+		size_t chars = 0;
+		for (size_t i = 0; i < num_col + num_row; ++i)
+			chars += lengths[i];
+
+		const char* p = in.take(chars);
+		lp.col_names_.reserve(num_col);
+		lp.row_names_.reserve(num_row);
+
+		for (size_t i = 0; i < num_col + num_row; ++i) {
+			(i < num_col ? lp.col_names_ : lp.row_names_).emplace_back(p, lengths[i]);
+			p += lengths[i];
+		}
+	}
+
+	basis.clear();
+
+	if (header.flags & ModelSnapshotHeader::kBasis) {
+		in.read(basis.col_status, num_col);
+		in.read(basis.row_status, num_row);
+		basis.valid = true;
+		basis.alien = false;
+	}
+}
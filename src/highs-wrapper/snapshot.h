@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+
+#include "highs/Highs.h"
+
+/// <summary>
+/// Versioned binary image of a HighsLp: a fixed header followed by the raw arrays in a
+/// fixed order (costs, bounds, matrix, integrality, names, basis), each padded to 8 bytes.
+/// Written front to back in one pass and read through a memory map, so loading is a check
+/// of the header and a copy of each array, without parsing. Files are only read back on
+/// machines with the same byte order and HighsInt width, which the header records.
+/// </summary>
+struct ModelSnapshotHeader
+{
+    static const uint32_t kVersion = 1;
+
+    enum Flags : uint32_t {
+        kColwise = 1,       // a_matrix_ is column-wise, row-wise otherwise
+        kIntegrality = 2,
+        kNames = 4,
+        kBasis = 8,
+    };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t int_size;
+    int64_t num_col, num_row, num_nz;
+    int32_t sense;
+    uint32_t flags;
+    double offset;
+
+    // size of the whole file, a shorter file was truncated
+    uint64_t size;
+};
+
+// names are written when asked for and lp has them, the basis when it is non-null and valid for lp
+void writeModelSnapshot(const std::string& filename, const HighsLp& lp, bool names, const HighsBasis* basis);
+
+// basis is left invalid when the snapshot has none; throws std::runtime_error on a
+// missing, truncated or incompatible file
+void readModelSnapshot(const std::string& filename, HighsLp& lp, HighsBasis& basis);
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/// <summary>
+/// Read-only view of solution values held by a Highs instance, indexed like the model's
+/// columns or rows. Borrows the vector, so it is only valid until the next solve or model
+/// change.
+/// </summary>
+class ModelValueSpan
+{
+  private:
+    const double* values = nullptr;
+    size_t count = 0;
+
+  public:
+    ModelValueSpan() {}
+    ModelValueSpan(const std::vector<double>& v) : values(v.data()), count(v.size()) {}
+
+    const double* data() const { return values; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const double* begin() const { return values; }
+    const double* end() const { return values + count; }
+
+    double operator[](size_t i) const { return values[i]; }
+
+    double at(size_t i) const {
+        if (i >= count)
+            throw std::out_of_range("i");
+        return values[i];
+    }
+};
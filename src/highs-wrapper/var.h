@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -6,21 +7,43 @@
 
 class OptimizationModel;
 
+/// <summary>
+/// Compact reference to a model column, as stored in expressions.
+/// The id is a stable slot in the model, the generation tells a live column
+/// apart from a removed one whose slot has since been reused.
+/// </summary>
+struct ModelVarRef
+{
+    uint32_t id;
+    uint32_t gen;
+
+    bool operator==(const ModelVarRef& r) const { return id == r.id && gen == r.gen; }
+};
+
+struct ModelTerm
+{
+    ModelVarRef var;
+    double coeff;
+};
+
 class ModelColumn
 {
   private:
     OptimizationModel* model;
     int col;
+    ModelVarRef ref;
+    uint32_t name;  // id in the model's column NameTable
 
   public:
     friend class ModelVar;
     friend class OptimizationModel;
+    friend class ModelLinearExpression;
+    friend struct ModelVarNode;
 
-    std::string name;
     double lb, ub;
     bool integer;
 
-    ModelColumn(OptimizationModel* model, int col_no, std::string name = "") : model(model), col(col_no), name(name) {
+    ModelColumn(OptimizationModel* model, int col_no, ModelVarRef ref, uint32_t name) : model(model), col(col_no), ref(ref), name(name) {
         lb = -kHighsInf; 
         ub = kHighsInf; 
         integer = false;
@@ -35,6 +58,7 @@ class ModelVar
   public:
     friend class OptimizationModel;
     friend class ModelLinearExpression;
+    friend struct ModelVarNode;
 
     ModelVar() {}
     ModelVar(const ModelVar& var) : column(var.column) {}
@@ -49,22 +73,12 @@ class ModelVar
         return column ? column->col : -2;
     }
 
-    void remove() {
-        throw std::runtime_error("Not implemented");
+    void remove();
 
-        //if (column) {
-        //    column->model->remove(*this);
-        //    column.reset();
-        //}
-    }
+    // value at the model's last solution, see OptimizationModel::getValue
+    double getValue() const;
 
-    //double getValue() const { 
-    //    return column->model->highs.getSolution().col_value[index()];
-    //}
-
-    std::string getName() const {
-        return column->name;
-    }
+    std::string getName() const;
 
     bool sameAs(ModelVar v2) {
         return column.get() == v2.column.get();
@@ -0,0 +1,399 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+
+#include "highs-wrapper/optimization_model.h"
+
+//
+// Checks of wrapper behaviour that doesn't depend on the values a solve finds.
+// usage: model-test, exits with the number of failed checks
+//
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; ++failures; } } while (0)
+
+// a removed column's slot is reused by the next addVar before update() compacts the rows
+static void chgCoeffAfterSlotReuse()
+{
+	OptimizationModel m;
+	auto x = m.addVar();
+	auto y = m.addVar();
+	auto c = m.addConstr(x + y <= 1);
+
+	m.chgCoeff(c, x, 5.0);	// indexes the row
+	m.remove(x);
+	auto z = m.addVar();
+
+	m.chgCoeff(c, z, 1.0);
+	m.chgCoeff(c, z, 2.0);
+	CHECK(m.getCoeff(c, z) == 2.0);
+	CHECK(m.getCoeff(c, y) == 1.0);
+
+	m.update();
+	CHECK(m.getCoeff(c, z) == 2.0);
+
+	ModelLinearExpression row = m.getRow(c);
+	CHECK(row.size() == 2);
+}
+
+// chgCoeff then getCoeff gives the value back, whether the row is new, in highs, adopted by a
+// copy or streamed by a row builder
+static void coeffRoundTrip()
+{
+	OptimizationModel m;
+	auto x = m.addVar();
+	auto y = m.addVar();
+	auto fresh = m.addConstr(x + y <= 1);
+	auto synced = m.addConstr(x - y >= 0);
+	m.update();
+	auto streamed = m.rowBuilder().add(x, 2.0).add(y, 3.0).commit(0.0, 4.0);
+	auto added = m.addConstr(2 * x <= 3);
+
+	CHECK(m.getCoeff(streamed, x) == 2.0);
+	CHECK(m.getCoeff(streamed, y) == 3.0);
+	CHECK(m.getCoeff(added, y) == 0.0);
+
+	m.chgCoeff(added, y, 5.0);
+	m.chgCoeff(synced, x, 4.0);
+	m.chgCoeff(streamed, y, 0.0);
+	m.chgCoeff(fresh, x, 6.0);
+	CHECK(m.getCoeff(added, y) == 5.0);
+	CHECK(m.getCoeff(synced, x) == 4.0);
+	CHECK(m.getCoeff(streamed, y) == 0.0);
+	CHECK(m.getCoeff(streamed, x) == 2.0);
+	CHECK(m.getCoeff(fresh, x) == 6.0);
+
+	m.update();
+	OptimizationModel copy(m);
+	ModelConstraint adopted = copy.getConstr(streamed.index());
+	ModelVar cx = copy.getVar(x.index()), cy = copy.getVar(y.index());
+
+	CHECK(copy.getCoeff(adopted, cx) == 2.0);
+	copy.chgCoeff(adopted, cy, 7.0);
+	copy.chgCoeff(adopted, cx, 0.0);
+	CHECK(copy.getCoeff(adopted, cy) == 7.0);
+	CHECK(copy.getCoeff(adopted, cx) == 0.0);
+	CHECK(copy.getRow(adopted).size() == 1);
+
+	// the source model is unchanged
+	CHECK(m.getCoeff(streamed, x) == 2.0);
+	CHECK(m.getCoeff(streamed, y) == 0.0);
+}
+
+// a row builder commits rows, drops an uncommitted row and sums a column added twice
+static void rowBuilderRows()
+{
+	OptimizationModel m;
+	auto x = m.addVar();
+	auto y = m.addVar();
+
+	{
+		auto builder = m.rowBuilder();
+		builder.add(x, 1.0).add(y, 2.0).commit(-kHighsInf, 3.0);
+		builder.add(x, 5.0);
+	}
+
+	ModelConstraint c = m.rowBuilder().add(x, 1.0).add(y, 1.0).add(x, 2.0).commit(0.0, 1.0);
+	ModelConstraint d = m.rowBuilder().add(x, 1.0).add(y, 4.0).add(x, -1.0).commit(0.0, 1.0);
+	CHECK(m.getCoeff(c, x) == 3.0);
+	CHECK(m.getCoeff(d, x) == 0.0);
+	CHECK(m.getCoeff(d, y) == 4.0);
+
+	m.update();
+	CHECK(m.highs.getLp().num_row_ == 3);
+	CHECK(m.getRow(m.getConstr(0)).size() == 2);
+	CHECK(m.getRow(c).size() == 2);
+	CHECK(m.getRow(d).size() == 1);
+	CHECK(m.getCoeff(c, x) == 3.0);
+}
+
+// rows in highs may have no wrapper expression, so assemble() refuses synced models
+static void assembleSyncedModel()
+{
+	OptimizationModel m;
+	auto x = m.addVar();
+	m.rowBuilder().add(x, 1.0).commit(0.0, 1.0);
+
+	HighsModel model;
+	m.assemble(model);
+	CHECK(model.lp_.num_row_ == 1);
+
+	m.update();
+
+	bool thrown = false;
+	try {
+		m.assemble(model);
+	}
+	catch (const std::logic_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+// rows added after a removal take the term buffers of the removed rows from the arena
+static void rowsAfterRemoval()
+{
+	OptimizationModel m;
+	std::vector<ModelVar> x;
+	for (int i = 0; i < 8; ++i)
+		x.push_back(m.addVar());
+
+	auto a = m.addConstr(quicksum(x) <= 1);
+	auto b = m.addConstr(x[0] + x[1] <= 1);
+	m.remove(a);
+	m.update();
+
+	auto c = m.addConstr(quicksum(8, [&](size_t i) { return (i + 1.0) * x[i]; }) <= 2);
+	m.update();
+
+	ModelLinearExpression row = m.getRow(c);
+	CHECK(row.size() == 8);
+	for (int i = 0; i < (int)row.size(); ++i)
+		CHECK(row.getCoeff(i) == row.getVar(i).index() + 1.0);
+	CHECK(m.getRow(b).size() == 2);
+
+	// rows hold only arena memory, so tearing the model down doesn't visit them
+	CHECK(ArenaReleased<ModelRow>::value);
+}
+
+// code written when arithmetic returned ModelLinearExpression keeps compiling with auto
+static void autoExpressions()
+{
+	OptimizationModel m;
+	auto x = m.addVar();
+	auto y = m.addVar();
+	auto z = m.addVar();
+
+	auto e = x + y;
+	e += z;
+	e += 2 * x;
+	e -= y;
+	e.compress();
+	CHECK(e.size() == 2);
+	CHECK(e.getCoeff(0) == 3.0);
+	CHECK(e.getCoeff(1) == 1.0);
+
+	auto f = 2 * x + 1;
+	f *= 2;
+	f = f + y;
+	CHECK(f.size() == 2);
+	CHECK(f.getConstant() == 2.0);
+
+	ModelLinearExpression g = e;
+	g += f;
+	CHECK(g.size() == 4);
+
+	auto c = m.addConstr(e + f <= 10);
+	m.setObjective(e);
+	ModelLinearExpression row = m.getRow(c);
+	CHECK(row.size() == 4);
+	CHECK(row.getRHS() == 10.0 && row.getConstant() == 2.0);
+}
+
+// a constraint built through expression templates has the row of the expression built one
+static void templateConstraints()
+{
+	OptimizationModel m;
+	auto x = m.addVar();
+	auto y = m.addVar();
+
+	ModelLinearExpression lhs = x;
+	lhs += 2 * ModelLinearExpression(y);
+	lhs += 3;
+
+	auto a = m.addConstr(x + 2 * y + 3 <= 5);
+	auto b = m.addConstr(std::move(lhs) <= 5);
+	auto c = m.addConstr(1 <= x - y / 2 <= 4);
+
+	ModelLinearExpression ra = m.getRow(a), rb = m.getRow(b), rc = m.getRow(c);
+	CHECK(ra.size() == rb.size());
+	for (int i = 0; i < (int)ra.size() && i < (int)rb.size(); ++i) {
+		CHECK(ra.getVar(i).index() == rb.getVar(i).index());
+		CHECK(ra.getCoeff(i) == rb.getCoeff(i));
+	}
+	CHECK(ra.getRHS() == rb.getRHS());
+	CHECK(ra.getInequality() == rb.getInequality());
+
+	CHECK(rc.getInequality() == ModelLinearExpression::Inequality::Range);
+	CHECK(rc.getLHS() == 1.0 && rc.getRHS() == 4.0);
+	CHECK(rc.size() == 2 && rc.getCoeff(1) == -0.5);
+}
+
+// every kernel the CPU has gives the activities and violation of the scalar one, on rows
+// of every length around the vector widths
+static void evaluateKernels()
+{
+	HighsSparseMatrix a;
+	a.format_ = MatrixFormat::kRowwise;
+	a.num_col_ = 40;
+	a.num_row_ = 40;
+	a.start_ = { 0 };
+	for (HighsInt r = 0; r < a.num_row_; ++r) {
+		for (HighsInt k = 0; k < r; ++k) {
+			a.index_.push_back((k * 7 + r) % a.num_col_);
+			a.value_.push_back(1.0 + 0.25 * ((k + r) % 5));
+		}
+		a.start_.push_back(a.index_.size());
+	}
+
+	std::vector<double> x(a.num_col_), lower(a.num_row_, -kHighsInf), upper(a.num_row_);
+	for (HighsInt c = 0; c < a.num_col_; ++c)
+		x[c] = 0.5 * (c % 3);
+	for (HighsInt r = 0; r < a.num_row_; ++r)
+		upper[r] = 0.25 * r;
+
+	std::vector<double> expected(a.num_row_);
+	double worst = evaluateRows(a, lower.data(), upper.data(), x.data(), expected.data(), 0, a.num_row_, ModelKernel::Scalar);
+	CHECK(worst > 0.0);
+
+	for (ModelKernel kernel : { ModelKernel::Avx2, ModelKernel::Avx512 }) {
+		std::vector<double> activity(a.num_row_);
+		double w = evaluateRows(a, lower.data(), upper.data(), x.data(), activity.data(), 0, a.num_row_, kernel);
+		CHECK(std::fabs(w - worst) <= 1e-9 * (1.0 + worst));
+		for (HighsInt r = 0; r < a.num_row_; ++r)
+			CHECK(std::fabs(activity[r] - expected[r]) <= 1e-9 * (1.0 + std::fabs(expected[r])));
+
+		// a part of the rows, without activities
+		CHECK(evaluateRows(a, lower.data(), upper.data(), x.data(), nullptr, 5, 9, kernel) ==
+			evaluateRows(a, lower.data(), upper.data(), x.data(), nullptr, 5, 9, ModelKernel::Scalar));
+	}
+
+	// through the model, with threads asked for but the matrix below kEvaluateNonzeros
+	OptimizationModel m;
+	auto u = m.addVar(0.0, 1.0);
+	auto v = m.addVar(0.0, 1.0);
+	m.addConstr(u + 2 * v <= 2);
+	m.addConstr(u - v >= 0);
+
+	double point[] = { 1.0, 1.0 };
+	ModelEvaluation result = m.evaluate(point, 0);
+	CHECK(result.row_activity.size() == 2);
+	CHECK(result.row_activity[0] == 3.0 && result.row_activity[1] == 0.0);
+	CHECK(result.max_infeasibility == 1.0);
+}
+
+// a corrupt count in the header is rejected before it is used to size a read
+static void snapshotCorruptCount()
+{
+	HighsLp lp;
+	lp.num_col_ = 1;
+	lp.col_cost_ = { 1.0 };
+	lp.col_lower_ = { 0.0 };
+	lp.col_upper_ = { 1.0 };
+	lp.a_matrix_.start_ = { 0, 0 };
+
+	const char* filename = "model-test.snapshot";
+	writeModelSnapshot(filename, lp, false, nullptr);
+
+	FILE* file = fopen(filename, "r+b");
+	ModelSnapshotHeader header;
+	CHECK(fread(&header, sizeof(header), 1, file) == 1);
+	header.num_col = std::numeric_limits<HighsInt>::max();
+	fseek(file, 0, SEEK_SET);
+	CHECK(fwrite(&header, sizeof(header), 1, file) == 1);
+	fclose(file);
+
+	HighsBasis basis;
+	bool thrown = false;
+	try {
+		readModelSnapshot(filename, lp, basis);
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	remove(filename);
+}
+
+// the LP basis from before a MIP solve is the start of the next LP solve once the integer
+// column is removed again; the iteration limit leaves highs with the basis it started from
+static void warmStartAcrossMip()
+{
+	OptimizationModel m;
+	m.highs.setOptionValue("output_flag", false);
+	auto x = m.addVar(0, 1);
+	auto y = m.addVar(0, 1);
+	m.addConstr(x + 2 * y <= 1.5);
+	m.maximize(x + y);
+	m.optimize();
+
+	HighsBasis lp = m.highs.getBasis();
+	CHECK(lp.valid);
+
+	auto z = m.addIntegral(0, 2);
+	auto bound = m.addConstr(z <= 1);
+	m.maximize(x + y + z);
+	m.optimize();
+
+	m.remove(bound);
+	m.remove(z);
+	m.maximize(x + y);
+	m.highs.setOptionValue("simplex_iteration_limit", (HighsInt)0);
+	m.optimize();
+
+	const HighsBasis& start = m.highs.getBasis();
+	CHECK(start.valid);
+	CHECK(start.col_status.size() == 2 && start.row_status.size() == 1);
+	CHECK(start.col_status == lp.col_status);
+	CHECK(start.row_status == lp.row_status);
+}
+
+// the relaxation view solves on its own highs: the model and its copies stay the MIP, the view
+// picks up appended columns and rows and is passed anew after other changes
+static void relaxationView()
+{
+	OptimizationModel m;
+	m.highs.setOptionValue("output_flag", false);
+	auto x = m.addIntegral(0, 3);
+	auto y = m.addVar(0, 1);
+	auto c = m.addConstr(x + y <= 2.5);
+	m.maximize(x + y);
+
+	auto lp = m.relaxation();
+	CHECK(!lp.highs.getLp().isMip());
+	CHECK(m.highs.getLp().isMip());
+	CHECK(OptimizationModel(m).highs.getLp().isMip());
+
+	lp.optimize();
+	CHECK(m.highs.getLp().isMip());
+
+	auto z = m.addIntegral(0, 1);
+	m.addConstr(x + z <= 3);
+	m.maximize(x + y + z);
+	lp.optimize();
+
+	double v = 0;
+	CHECK(lp.highs.getNumCol() == 3 && lp.highs.getNumRow() == 2);
+	CHECK(!lp.highs.getLp().isMip());
+	lp.highs.getCoeff(1, z.index(), v);
+	CHECK(v == 1.0);
+	CHECK(lp.highs.getLp().col_cost_[z.index()] == 1.0);
+
+	m.chgCoeff(c, y, 2.0);
+	lp.optimize();
+	lp.highs.getCoeff(0, y.index(), v);
+	CHECK(v == 2.0);
+	CHECK(lp.getValue(z) >= 0.0);
+
+	OptimizationModel relaxed = m.relax();
+	CHECK(!relaxed.highs.getLp().isMip());
+	CHECK(m.highs.getLp().isMip());
+}
+
+int main()
+{
+	chgCoeffAfterSlotReuse();
+	coeffRoundTrip();
+	rowBuilderRows();
+	assembleSyncedModel();
+	rowsAfterRemoval();
+	autoExpressions();
+	templateConstraints();
+	evaluateKernels();
+	snapshotCorruptCount();
+	warmStartAcrossMip();
+	relaxationView();
+	return failures;
+}